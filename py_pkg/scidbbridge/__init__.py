@@ -24,6 +24,7 @@
 import pyarrow
 import boto3
 import itertools
+import numpy
 import os
 import os.path
 import pandas
@@ -34,6 +35,61 @@ from .driver import Driver
 
 __version__ = '19.11.1'
 
+# Arrow types of SciDB types, see ArrowReader::scidb2ArrowSchema in
+# src/XIndex.cpp
+ARROW_TYPES = {
+    'binary': pyarrow.binary(),
+    'bool': pyarrow.bool_(),
+    'char': pyarrow.utf8(),
+    'datetime': pyarrow.timestamp('s'),
+    'double': pyarrow.float64(),
+    'float': pyarrow.float32(),
+    'int8': pyarrow.int8(),
+    'int16': pyarrow.int16(),
+    'int32': pyarrow.int32(),
+    'int64': pyarrow.int64(),
+    'string': pyarrow.utf8(),
+    'uint8': pyarrow.uint8(),
+    'uint16': pyarrow.uint16(),
+    'uint32': pyarrow.uint32(),
+    'uint64': pyarrow.uint64(),
+}
+
+# Fence index layout, see XIndexFence in src/XIndex.cpp
+FENCE_VERSION = 1
+FENCE_HEADER_SIZE = 5
+FENCE_PAGE_SIZE = 65536
+
+
+def murmur3_32(data, seed=0):
+    """MurmurHash3 x86 32-bit, see murmurHash3 in src/Driver.cpp"""
+    c1, c2, mask = 0xcc9e2d51, 0x1b873593, 0xffffffff
+
+    def rotl(x, r):
+        return ((x << r) | (x >> (32 - r))) & mask
+
+    h = seed
+    n_blocks = len(data) // 4
+    for i in range(n_blocks):
+        k = int.from_bytes(data[i * 4:i * 4 + 4], 'little')
+        k = rotl((k * c1) & mask, 15)
+        h ^= (k * c2) & mask
+        h = (rotl(h, 13) * 5 + 0xe6546b64) & mask
+
+    tail = data[n_blocks * 4:]
+    if tail:
+        k = int.from_bytes(tail, 'little')
+        k = rotl((k * c1) & mask, 15)
+        h ^= (k * c2) & mask
+
+    h ^= len(data)
+    h ^= h >> 16
+    h = (h * 0x85ebca6b) & mask
+    h ^= h >> 13
+    h = (h * 0xc2b2ae35) & mask
+    h ^= h >> 16
+    return h
+
 
 class Array(object):
     """Wrapper for SciDB array stored externally"""
@@ -43,6 +99,7 @@ class Array(object):
 
         self._metadata = None
         self._schema = None
+        self._locations = None
 
     def __iter__(self):
         return (i for i in (self.url, ))
@@ -70,7 +127,30 @@ class Array(object):
                 self.metadata['schema'])
         return self._schema
 
+    @property
+    def arrow_schema(self):
+        return pyarrow.schema(
+            [(a.name, ARROW_TYPES[a.type_name]) for a in self.schema.atts] +
+            [(d.name, pyarrow.int64()) for d in self.schema.dims])
+
+    def is_column_layout(self):
+        return self.metadata.get('compression_layout') == 'column'
+
+    def column_compression(self):
+        """Codec of each column, attributes followed by dimensions. Arrays
+        saved with compression auto record one codec per column, see
+        Metadata::getColumnCompression in src/Driver.cpp"""
+        columns = self.metadata.get('compression_columns')
+        if columns is None:
+            return [self.metadata['compression']] * (
+                len(self.schema.atts) + len(self.schema.dims))
+        codecs = [column.split(':')[0] for column in columns.split(',')]
+        return [None if codec == 'none' else codec for codec in codecs]
+
     def read_index(self):
+        if self.metadata.get('index_format') == 'fence':
+            return self.read_index_fence()
+
         # Read index as Arrow Table
         tables = []
         for index_url in Driver.list('{}/index'.format(self.url)):
@@ -87,8 +167,42 @@ class Array(object):
                           inplace=True,
                           ignore_index=True)
 
+        # Packed arrays store the chunk location after the chunk
+        # coordinates, see XIndex::getIndexDimensions in src/XIndex.h
+        if self.is_packed():
+            dim_names = [d.name for d in self.schema.dims]
+            self._locations = dict(
+                zip(map(tuple, index[dim_names].values),
+                    map(tuple, index[list(Array.location_columns)].values)))
+            index = index[dim_names]
+
         return index
 
+    def read_index_fence(self):
+        dim_names = [d.name for d in self.schema.dims]
+        n_dims = len(dim_names)
+
+        header = numpy.frombuffer(
+            Driver.read('{}/index/fence'.format(self.url)),
+            dtype='<i8')
+        if header[0] != FENCE_VERSION or header[1] != n_dims:
+            raise Exception('Invalid index fence header')
+        n_records, records_per_page, pages_per_object = header[2:5]
+        n_pages = -(-n_records // records_per_page)
+        n_objects = -(-n_pages // pages_per_object)
+
+        # Records are sorted, objects are read in order
+        records = [numpy.frombuffer(
+            Driver.read('{}/index/r_{}'.format(self.url, i)),
+            dtype='<i8') for i in range(n_objects)]
+        if records:
+            records = numpy.concatenate(records)
+        else:
+            records = numpy.empty(0, dtype='<i8')
+
+        return pandas.DataFrame(records.reshape(-1, n_dims),
+                                columns=dim_names)
+
     def build_index(self):
         dims = self.schema.dims
         index = pandas.DataFrame.from_records(
@@ -143,13 +257,17 @@ class Array(object):
         if split_size is None:
             split_size = int(self.metadata['index_split'])
 
+        # Remove existing index
+        Driver.delete_all('{}/index'.format(self.url))
+
+        if self.metadata.get('index_format') == 'fence':
+            self.write_index_fence(index, split_size)
+            return
+
         index_schema = pyarrow.schema(
             [(d.name, pyarrow.int64()) for d in self.schema.dims])
         chunk_size = split_size // len(index.columns)
 
-        # Remove existing index
-        Driver.delete_all('{}/index'.format(self.url))
-
         # Write new index
         i = 0
         for offset in range(0, len(index), chunk_size):
@@ -163,6 +281,39 @@ class Array(object):
             sink.close()
             i += 1
 
+        # Index is no longer partitioned by instance
+        if 'index_partition' in self.metadata:
+            del self.metadata['index_partition']
+            del self.metadata['index_partition_split']
+            Driver.write_metadata(self.url,
+                                  Array.metadata_to_string(self.metadata))
+
+    def write_index_fence(self, index, split_size):
+        n_dims = len(index.columns)
+        records = numpy.ascontiguousarray(index.to_numpy(dtype='<i8'))
+        n_records = len(records)
+
+        records_per_page = max(1, FENCE_PAGE_SIZE // (n_dims * 8))
+        pages_per_object = max(1, split_size // n_dims // records_per_page)
+        records_per_object = records_per_page * pages_per_object
+
+        # Write records, then the fence with the first record of
+        # each page
+        for i, offset in enumerate(range(0, n_records, records_per_object)):
+            Driver.write(
+                '{}/index/r_{}'.format(self.url, i),
+                records[offset:offset + records_per_object].tobytes())
+
+        header = numpy.array((FENCE_VERSION,
+                              n_dims,
+                              n_records,
+                              records_per_page,
+                              pages_per_object),
+                             dtype='<i8')
+        Driver.write('{}/index/fence'.format(self.url),
+                     header.tobytes() +
+                     records[::records_per_page].tobytes())
+
     def get_chunk(self, *argv):
         return Chunk(self, *argv)
 
@@ -176,6 +327,14 @@ class Array(object):
             pass
         return res
 
+    @staticmethod
+    def metadata_to_string(input):
+        return ''.join(
+            '{}\t{}\n'.format(key,
+                               'none' if key == 'compression' and val is None
+                               else val)
+            for (key, val) in input.items())
+
     @staticmethod
     def coords_to_url_suffix(coords, dims):
         parts = ['c']
@@ -197,6 +356,34 @@ class Array(object):
             parts.append(part)
         return '_'.join(map(str, parts))
 
+    @staticmethod
+    def chunk_url_suffix(part, chunk_fanout=0):
+        """Chunk object path relative to the array, see
+        Metadata::chunkObjectName in src/Driver.cpp"""
+        if not chunk_fanout:
+            return 'chunks/{}'.format(part)
+        width = len('{:x}'.format(chunk_fanout - 1))
+        return 'chunks/{:0{}x}/{}'.format(
+            murmur3_32(part.encode()) % chunk_fanout, width, part)
+
+    location_columns = ('chunk_pack', 'chunk_offset', 'chunk_length')
+
+    def is_packed(self):
+        return int(self.metadata.get('pack_size', 0)) > 0
+
+    def chunk_location(self, coords):
+        """Pack id, offset, and length of the chunk in a packed array"""
+        if self._locations is None:
+            self.read_index()
+        return self._locations[tuple(coords)]
+
+    @staticmethod
+    def pack_url_suffix(pack, chunk_fanout=0):
+        """Pack object path relative to the array, see
+        Metadata::packObjectName in src/Driver.cpp"""
+        return Array.chunk_url_suffix(
+            'p_{}'.format(pack), chunk_fanout).replace('chunks/', 'packs/', 1)
+
     @staticmethod
     def url_to_coords(url, dims):
         part = url[url.rindex('/') + 1:]
@@ -224,8 +411,17 @@ class Chunk(object):
                  'each dimension.').format(len(argv),
                                            len(self.array.schema.dims)))
 
-        part = Array.coords_to_url_suffix(self.coords, dims)
-        self.url = '{}/chunks/{}'.format(self.array.url, part)
+        chunk_fanout = int(self.array.metadata.get('chunk_fanout', 0))
+        self.location = None
+        if self.array.is_packed():
+            (pack, offset, length) = self.array.chunk_location(argv)
+            self.location = (offset, length)
+            self.url = '{}/{}'.format(
+                self.array.url, Array.pack_url_suffix(pack, chunk_fanout))
+        else:
+            part = Array.coords_to_url_suffix(self.coords, dims)
+            self.url = '{}/{}'.format(
+                self.array.url, Array.chunk_url_suffix(part, chunk_fanout))
         self._table = None
 
     def __iter__(self):
@@ -244,11 +440,26 @@ class Chunk(object):
     @property
     def table(self):
         if self._table is None:
-            self._table = Driver.create_reader(
-                self.url,
-                compression=self.array.metadata['compression']).read_all()
+            compression = self.array.metadata['compression']
+            if self.array.is_column_layout():
+                self._table = Driver.read_columns(
+                    self._read(),
+                    self.array.arrow_schema,
+                    self.array.column_compression(),
+                    self.array.metadata.get('compression_filter'))
+            elif self.location is not None:
+                self._table = Driver.create_buffer_reader(
+                    self._read(), compression).read_all()
+            else:
+                self._table = Driver.create_reader(
+                    self.url, compression=compression).read_all()
         return self._table
 
+    def _read(self):
+        if self.location is not None:
+            return Driver.read_range(self.url, *self.location)
+        return Driver.read(self.url)
+
     def to_pandas(self):
         return pyarrow.Table.to_pandas(self.table)
 
@@ -293,6 +504,15 @@ class Chunk(object):
         self._table = self._table.replace_schema_metadata()
 
     def save(self):
+        if self.location is not None:
+            raise Exception('Chunks of packed arrays cannot be saved')
+        if self.array.is_column_layout():
+            Driver.write(self.url,
+                         Driver.write_columns(
+                             self._table,
+                             self.array.column_compression(),
+                             self.array.metadata.get('compression_filter')))
+            return
         sink = Driver.create_writer(
             self.url,
             schema=self._table.schema,
@@ -22,8 +22,10 @@
 # END_COPYRIGHT
 
 import boto3
+import numpy
 import os
 import pyarrow
+import struct
 import urllib.parse
 
 
@@ -61,9 +63,12 @@ class Driver:
         # File System
         elif parts.scheme == 'file':
             path = os.path.join(parts.netloc, parts.path)
-            for fn in os.listdir(path):
-                if os.path.isfile(os.path.join(path, fn)):
-                    yield 'file://' + os.path.join(path, fn)
+            # Include sub-directories, e.g., chunk fan-out, like S3
+            for (dir_path, _, fns) in os.walk(path):
+                for fn in fns:
+                    # Skip temporary files of writes in progress
+                    if not fn.startswith('.'):
+                        yield 'file://' + os.path.join(dir_path, fn)
 
         else:
             raise Exception('URL {} not supported'.format(url))
@@ -88,7 +93,28 @@ class Driver:
             raise Exception('URL {} not supported'.format(url))
 
     @staticmethod
-    def create_reader(url, compression=None):
+    def write_metadata(url, metadata):
+        parts = urllib.parse.urlparse(url)
+
+        # S3
+        if parts.scheme == 's3':
+            bucket = parts.netloc
+            key = parts.path[1:] + '/metadata'
+            Driver.s3_client().put_object(Body=metadata,
+                                          Bucket=bucket,
+                                          Key=key)
+
+        # File System
+        elif parts.scheme == 'file':
+            path = os.path.join(parts.netloc, parts.path, 'metadata')
+            with open(path, 'w') as f:
+                f.write(metadata)
+
+        else:
+            raise Exception('URL {} not supported'.format(url))
+
+    @staticmethod
+    def read(url):
         parts = urllib.parse.urlparse(url)
 
         # S3
@@ -96,10 +122,253 @@ class Driver:
             bucket = parts.netloc
             key = parts.path[1:]
             obj = Driver.s3_client().get_object(Bucket=bucket, Key=key)
-            buf = obj['Body'].read()
+            return obj['Body'].read()
+
+        # File System
+        elif parts.scheme == 'file':
+            path = os.path.join(parts.netloc, parts.path)
+            with open(path, 'rb') as f:
+                return f.read()
+
+        else:
+            raise Exception('URL {} not supported'.format(url))
+
+    @staticmethod
+    def read_range(url, offset, length):
+        parts = urllib.parse.urlparse(url)
+
+        # S3
+        if parts.scheme == 's3':
+            bucket = parts.netloc
+            key = parts.path[1:]
+            obj = Driver.s3_client().get_object(
+                Bucket=bucket,
+                Key=key,
+                Range='bytes={}-{}'.format(offset, offset + length - 1))
+            return obj['Body'].read()
+
+        # File System
+        elif parts.scheme == 'file':
+            path = os.path.join(parts.netloc, parts.path)
+            with open(path, 'rb') as f:
+                f.seek(offset)
+                return f.read(length)
+
+        else:
+            raise Exception('URL {} not supported'.format(url))
+
+    @staticmethod
+    def write(url, data):
+        parts = urllib.parse.urlparse(url)
+
+        # S3
+        if parts.scheme == 's3':
+            bucket = parts.netloc
+            key = parts.path[1:]
+            Driver.s3_client().put_object(Body=data,
+                                          Bucket=bucket,
+                                          Key=key)
+
+        # File System
+        elif parts.scheme == 'file':
+            path = os.path.join(parts.netloc, parts.path)
+            os.makedirs(os.path.dirname(path), exist_ok=True)
+            with open(path, 'wb') as f:
+                f.write(data)
+
+        else:
+            raise Exception('URL {} not supported'.format(url))
+
+    # Codecs without streaming support in Arrow. Objects are compressed
+    # in one block, prefixed by the uncompressed size, see
+    # ArrowReader::isBlockCompression in src/XIndex.h
+    block_compression = ('snappy', )
+
+    @staticmethod
+    def compress_block(buf, compression):
+        buf = pyarrow.py_buffer(buf)
+        return (struct.pack('<q', buf.size) +
+                pyarrow.compress(buf, codec=compression, asbytes=True))
+
+    @staticmethod
+    def decompress_block(buf, compression):
+        buf = pyarrow.py_buffer(buf)
+        (size, ) = struct.unpack('<q', buf.slice(0, 8).to_pybytes())
+        return pyarrow.decompress(buf.slice(8), size, codec=compression)
+
+    @staticmethod
+    def create_buffer_reader(buf, compression=None):
+        if compression in Driver.block_compression:
+            strm = pyarrow.BufferReader(
+                Driver.decompress_block(buf, compression))
+        else:
             strm = pyarrow.input_stream(pyarrow.py_buffer(buf),
                                         compression=compression)
-            return pyarrow.RecordBatchStreamReader(strm)
+        return pyarrow.RecordBatchStreamReader(strm)
+
+    # Column layout, see ARROW_COLUMN_MAGIC in src/XIndex.h
+    column_magic = b'XCOLUMN1'
+
+    @staticmethod
+    def column_codecs(compression, n_cols):
+        """One codec for all the columns or a list with a codec per
+        column"""
+        if isinstance(compression, (list, tuple)):
+            if len(compression) != n_cols:
+                raise Exception(
+                    '{} column codecs for {} columns'.format(
+                        len(compression), n_cols))
+            return compression
+        return [compression] * n_cols
+
+    @staticmethod
+    def filter_width(compression_filter, type, i_buf):
+        """Element width of buffer i_buf of a column of the type, if the
+        filter applies to it, 0 otherwise, see ArrowReader::filterWidth
+        in src/XIndex.cpp"""
+        if compression_filter in (None, 'none') or i_buf != 1:
+            return 0
+        try:
+            bit_width = type.bit_width
+        except ValueError:
+            return 0
+        if bit_width < 16 or bit_width % 8:
+            return 0
+        return bit_width // 8
+
+    @staticmethod
+    def shuffle(compression_filter, width, buf):
+        data = numpy.frombuffer(buf, dtype=numpy.uint8)
+        n = len(data) // width
+        if compression_filter == 'shuffle':
+            n_shuffled = n
+            head = data[:n * width].reshape(n, width).T
+        else:
+            # Groups of 8 elements, row r holds bit r % 8 of byte r / 8
+            n_shuffled = n - n % 8
+            bits = numpy.unpackbits(
+                data[:n_shuffled * width].reshape(n_shuffled, width),
+                axis=1, bitorder='little')
+            head = numpy.packbits(bits.T, axis=1, bitorder='little')
+        return head.tobytes() + data[n_shuffled * width:].tobytes()
+
+    @staticmethod
+    def unshuffle(compression_filter, width, buf):
+        data = numpy.frombuffer(buf, dtype=numpy.uint8)
+        n = len(data) // width
+        if compression_filter == 'shuffle':
+            n_shuffled = n
+            head = data[:n * width].reshape(width, n).T
+        else:
+            n_shuffled = n - n % 8
+            bits = numpy.unpackbits(
+                data[:n_shuffled * width].reshape(8 * width, n_shuffled // 8),
+                axis=1, bitorder='little')
+            head = numpy.packbits(bits.T, axis=1, bitorder='little')
+        return pyarrow.py_buffer(
+            head.tobytes() + data[n_shuffled * width:].tobytes())
+
+    @staticmethod
+    def read_columns(buf, schema, compression=None, compression_filter=None):
+        buf = pyarrow.py_buffer(buf)
+        view = memoryview(buf)
+        n_cols = len(schema)
+        footer_size = (2 * n_cols + 3) * 8 + len(Driver.column_magic)
+        if (len(view) < footer_size or
+                bytes(view[-len(Driver.column_magic):]) != Driver.column_magic):
+            raise Exception('Object is not in column layout')
+        footer = struct.unpack_from('<{}q'.format(2 * n_cols + 3),
+                                    view,
+                                    len(view) - footer_size)
+        if footer[-1] != n_cols:
+            raise Exception(
+                'Object has {} columns, schema has {} columns'.format(
+                    footer[-1], n_cols))
+        n_rows = footer[-2]
+        codecs = Driver.column_codecs(compression, n_cols)
+
+        arrays = []
+        for (i, field) in enumerate(schema):
+            pos = footer[i]
+            (n_bufs, ) = struct.unpack_from('<q', view, pos)
+            pos += 8
+            bufs = []
+            for i_buf in range(n_bufs):
+                (raw_len, stored_len) = struct.unpack_from('<2q', view, pos)
+                pos += 16
+                if raw_len < 0:
+                    bufs.append(None)
+                    continue
+                stored = buf.slice(pos, stored_len)
+                if stored_len != raw_len:
+                    stored = pyarrow.decompress(stored,
+                                                raw_len,
+                                                codec=codecs[i])
+                    width = Driver.filter_width(
+                        compression_filter, field.type, i_buf)
+                    if width > 0:
+                        stored = Driver.unshuffle(
+                            compression_filter, width, stored)
+                bufs.append(stored)
+                pos += (stored_len + 7) // 8 * 8
+            arrays.append(pyarrow.Array.from_buffers(
+                field.type, n_rows, bufs, null_count=footer[n_cols + 1 + i]))
+
+        return pyarrow.Table.from_arrays(arrays, schema=schema)
+
+    @staticmethod
+    def write_columns(table, compression=None, compression_filter=None):
+        parts = []
+        offsets = [0]
+        null_counts = []
+        codecs = Driver.column_codecs(compression, table.num_columns)
+        for (column, codec) in zip(table.combine_chunks().columns, codecs):
+            array = (column.chunk(0) if column.num_chunks > 0
+                     else pyarrow.array([], type=column.type))
+            bufs = array.buffers()
+            parts.append(struct.pack('<q', len(bufs)))
+            for (i_buf, raw) in enumerate(bufs):
+                if raw is None:
+                    parts.append(struct.pack('<2q', -1, 0))
+                    continue
+                stored = raw.to_pybytes()
+                if codec is not None and raw.size > 0:
+                    width = Driver.filter_width(
+                        compression_filter, column.type, i_buf)
+                    data = pyarrow.compress(
+                        Driver.shuffle(compression_filter, width, raw)
+                        if width > 0 else raw,
+                        codec=codec,
+                        asbytes=True)
+                    if len(data) < raw.size:
+                        stored = data
+                parts.append(struct.pack('<2q', raw.size, len(stored)))
+                parts.append(stored)
+                parts.append(bytes(-len(stored) % 8))
+            offsets.append(sum(map(len, parts)))
+            null_counts.append(array.null_count)
+
+        parts.append(struct.pack('<{}q'.format(len(offsets)), *offsets))
+        parts.append(struct.pack('<{}q'.format(len(null_counts)),
+                                 *null_counts))
+        parts.append(struct.pack('<2q', table.num_rows, table.num_columns))
+        parts.append(Driver.column_magic)
+        return b''.join(parts)
+
+    @staticmethod
+    def create_reader(url, compression=None):
+        parts = urllib.parse.urlparse(url)
+
+        if compression in Driver.block_compression:
+            return Driver.create_buffer_reader(Driver.read(url), compression)
+
+        # S3
+        if parts.scheme == 's3':
+            bucket = parts.netloc
+            key = parts.path[1:]
+            obj = Driver.s3_client().get_object(Bucket=bucket, Key=key)
+            buf = obj['Body'].read()
+            return Driver.create_buffer_reader(buf, compression)
 
         # File System
         elif parts.scheme == 'file':
@@ -114,6 +383,19 @@ class Driver:
     def create_writer(url, schema, compression=None):
         parts = urllib.parse.urlparse(url)
 
+        if compression in Driver.block_compression:
+            buf = pyarrow.BufferOutputStream()
+            writer = pyarrow.RecordBatchStreamWriter(buf, schema)
+
+            try:
+                yield writer
+            except GeneratorExit:
+                writer.close()
+                Driver.write(url,
+                             Driver.compress_block(buf.getvalue(),
+                                                   compression))
+            return
+
         # S3
         if parts.scheme == 's3':
             bucket = parts.netloc
@@ -134,6 +416,7 @@ class Driver:
         # File System
         elif parts.scheme == 'file':
             path = os.path.join(parts.netloc, parts.path)
+            os.makedirs(os.path.dirname(path), exist_ok=True)
             stream = pyarrow.output_stream(path, compression=compression)
             writer = pyarrow.ipc.RecordBatchStreamWriter(stream, schema)
 
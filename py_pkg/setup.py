@@ -52,6 +52,7 @@ setup(
     packages=['scidbbridge'],
     install_requires=[
         'boto3>=1.14.12',
+        'numpy>=1.17.0',
         'pyarrow==0.16.0',
         'scidb-py>=19.11.2',
     ],
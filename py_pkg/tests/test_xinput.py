@@ -328,6 +328,93 @@ xsave(
                           'v': numpy.arange(0.0, float(size))}))
 
 
+# Test with Index Partitioned for Different Instance Counts
+@pytest.mark.parametrize('url, index_partition',
+                         itertools.product(test_urls, (None, 1, 3)))
+def test_index_partition(scidb_con, url, index_partition):
+    size = 300
+    url = '{}/index_partition_{}'.format(url, index_partition)
+    schema = '<v:int64> [i=0:{}:0:5]'.format(size - 1)
+
+    # Partition for the current number of instances by default
+    if index_partition is None:
+        index_partition = len(
+            scidb_con.iquery("list('instances')", fetch=True))
+
+    # Store
+    scidb_con.iquery("""
+xsave(
+  build({}, i),
+  '{}', index_split:100, index_partition:{})""".format(
+      schema, url, index_partition))
+
+    array = scidbbridge.Array(url)
+    assert array.metadata['index_partition'] == str(index_partition)
+    split = list(map(int, array.metadata['index_partition_split'].split(',')))
+    assert len(split) == index_partition + 1
+    pandas.testing.assert_frame_equal(
+        array.read_index(),
+        pandas.DataFrame(data={'i': range(0, size, 5)}))
+
+    # Input
+    array = scidb_con.iquery("xinput('{}')".format(url), fetch=True)
+    array = array.sort_values(by=['i']).reset_index(drop=True)
+
+    pandas.testing.assert_frame_equal(
+        array,
+        pandas.DataFrame({'i': range(size),
+                          'v': numpy.arange(0.0, float(size))}))
+
+
+# Test Index Cached Across Queries Is Invalidated by Changes
+@pytest.mark.parametrize('url', test_urls)
+def test_index_cache(scidb_con, url):
+    url = '{}/index_cache'.format(url)
+    schema = '<v:int64> [i=0:19:0:5]'
+
+    # Store
+    scidb_con.iquery("""
+xsave(
+  filter(build({}, i), i < 10),
+  '{}')""".format(schema, url))
+
+    # Input, Twice, Second Query Uses Cache
+    for _ in range(2):
+        array = scidb_con.iquery("xinput('{}')".format(url), fetch=True)
+        array = array.sort_values(by=['i']).reset_index(drop=True)
+
+        pandas.testing.assert_frame_equal(
+            array,
+            pandas.DataFrame({'i': range(10),
+                              'v': numpy.arange(0.0, 10.0)}))
+
+    # Update Adds Chunks
+    scidb_con.iquery("""
+xsave(
+  build({}, i),
+  '{}', update:true)""".format(schema, url))
+
+    array = scidb_con.iquery("xinput('{}')".format(url), fetch=True)
+    array = array.sort_values(by=['i']).reset_index(drop=True)
+
+    pandas.testing.assert_frame_equal(
+        array,
+        pandas.DataFrame({'i': range(20),
+                          'v': numpy.arange(0.0, 20.0)}))
+
+    # Re-write Index Without the Last Chunk
+    bridge_array = scidbbridge.Array(url)
+    bridge_array.write_index(bridge_array.read_index().iloc[:-1])
+
+    array = scidb_con.iquery("xinput('{}')".format(url), fetch=True)
+    array = array.sort_values(by=['i']).reset_index(drop=True)
+
+    pandas.testing.assert_frame_equal(
+        array,
+        pandas.DataFrame({'i': range(15),
+                          'v': numpy.arange(0.0, 15.0)}))
+
+
 # Test with Different Cache Sizes
 @pytest.mark.parametrize('url, cache_size',
                          itertools.product(test_urls, (None, 5000, 2500, 0)))
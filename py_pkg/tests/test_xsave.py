@@ -290,9 +290,10 @@ xsave(
 @pytest.mark.parametrize(('url', 'compression', 'sz_min', 'sz_max'),
                          ((url, *param)
                           for url in test_urls
-                          for param in zip(('default', 'none', 'gzip'),
-                                           (1500, 1500, 0),
-                                           (9999, 9999, 500))))
+                          for param in zip(('default', 'none', 'gzip',
+                                            'zstd', 'lz4', 'snappy'),
+                                           (1500, 1500, 0, 0, 0, 0),
+                                           (9999, 9999, 500, 500, 1500, 1500))))
 def test_compression(scidb_con, url, compression, sz_min, sz_max):
     prefix = 'compression_{}'.format(compression)
     url = '{}/{}'.format(url, prefix)
@@ -333,6 +334,215 @@ xsave(
     assert sz < sz_max
 
 
+@pytest.mark.parametrize(('url', 'compression', 'level'),
+                         ((url, *param)
+                          for url in test_urls
+                          for param in (('gzip', 1), ('zstd', 19), ('lz4', 9))))
+def test_compression_level(scidb_con, url, compression, level):
+    url = '{}/compression_level_{}'.format(url, compression)
+    schema = '<v:int64> [i=0:19:0:5; j=10:49:0:10]'
+
+    scidb_con.iquery("""
+xsave(
+  build({}, i + j),
+  '{}', compression:'{}', compression_level:{})""".format(
+      schema, url, compression, level))
+
+    array = scidbbridge.Array(url)
+
+    assert array.metadata == {**base_metadata,
+                              **{'schema': '{}'.format(schema),
+                                 'compression': compression,
+                                 'compression_level': str(level)}}
+    pandas.testing.assert_frame_equal(
+        array.get_chunk(5, 30).to_pandas(),
+        pandas.DataFrame(data=((i + j, i, j)
+                               for i in range(5, 10)
+                               for j in range(30, 40)),
+                         columns=('v', 'i', 'j')))
+
+    # Level requires a codec with levels, within the codec range
+    for param in ("compression:'snappy', compression_level:1",
+                  'compression_level:1',
+                  "compression:'gzip', compression_level:50",
+                  "compression:'zstd', compression_level:23",
+                  "compression:'lz4', compression_level:-1"):
+        with pytest.raises(requests.exceptions.HTTPError):
+            scidb_con.iquery("""
+xsave(
+  build({}, i + j),
+  '{}_error', {})""".format(schema, url, param))
+
+
+@pytest.mark.parametrize(('url', 'compression'),
+                         ((url, compression)
+                          for url in test_urls
+                          for compression in ('none', 'lz4', 'zstd')))
+def test_compression_layout(scidb_con, url, compression):
+    url = '{}/compression_layout_{}'.format(url, compression)
+    schema = '<v:int64, w:double, s:string> [i=0:19:0:5; j=10:49:0:10]'
+
+    scidb_con.iquery("""
+xsave(
+  redimension(
+    apply(
+      build(<v:int64>[i=0:19:0:5; j=10:49:0:10], i + j),
+      w, iif(j % 3 = 0, null, double(i) / 4),
+      s, 's' + string(i)),
+    {}),
+  '{}', compression:'{}', compression_layout:'column')""".format(
+      schema, url, compression))
+
+    array = scidbbridge.Array(url)
+
+    assert array.metadata == {
+        **base_metadata,
+        **{'schema': '{}'.format(schema),
+           'compression': None if compression == 'none' else compression,
+           'compression_layout': 'column'}}
+    pandas.testing.assert_frame_equal(
+        array.get_chunk(5, 30).to_pandas(),
+        pandas.DataFrame(data=((i + j,
+                                None if j % 3 == 0 else i / 4,
+                                's{}'.format(i),
+                                i, j)
+                               for i in range(5, 10)
+                               for j in range(30, 40)),
+                         columns=('v', 'w', 's', 'i', 'j')))
+
+    # Only the projected attribute is decompressed
+    array = scidb_con.iquery(
+        "project(xinput('{}'), s)".format(url), fetch=True)
+    array = array.sort_values(by=['i', 'j']).reset_index(drop=True)
+    pandas.testing.assert_frame_equal(
+        array,
+        pandas.DataFrame(data=((i, j, 's{}'.format(i))
+                               for i in range(20)
+                               for j in range(10, 50)),
+                         columns=('i', 'j', 's')))
+
+
+@pytest.mark.parametrize('url', test_urls)
+def test_compression_filter(scidb_con, url):
+    schema = '<v:int64, w:double> [i=0:99:0:50; j=0:99:0:50]'
+    sizes = {}
+
+    for compression_filter in ('none', 'shuffle', 'bitshuffle'):
+        prefix = 'compression_filter_{}'.format(compression_filter)
+        url_filter = '{}/{}'.format(url, prefix)
+
+        scidb_con.iquery("""
+xsave(
+  redimension(
+    apply(
+      build(<v:int64>[i=0:99:0:50; j=0:99:0:50], i * 100 + j),
+      w, iif(j % 7 = 0, null, double(i * 100 + j) / 8)),
+    {}),
+  '{}', compression:'zstd', compression_layout:'column',
+        compression_filter:'{}')""".format(
+            schema, url_filter, compression_filter))
+
+        array = scidbbridge.Array(url_filter)
+
+        if compression_filter == 'none':
+            assert 'compression_filter' not in array.metadata
+        else:
+            assert array.metadata['compression_filter'] == compression_filter
+        gold = pandas.DataFrame(
+            data=((i * 100 + j,
+                   None if j % 7 == 0 else (i * 100 + j) / 8,
+                   i, j)
+                  for i in range(50, 100)
+                  for j in range(0, 50)),
+            columns=('v', 'w', 'i', 'j'))
+        pandas.testing.assert_frame_equal(
+            array.get_chunk(50, 0).to_pandas(), gold)
+
+        # Chunks saved from Python are read by xinput
+        chunk = array.get_chunk(50, 0)
+        gold['v'] = -gold['v']
+        chunk.from_pandas(gold)
+        chunk.save()
+        res = scidb_con.iquery(
+            "project(filter(xinput('{}'), i >= 50 and j < 50), v)".format(
+                url_filter),
+            fetch=True)
+        res = res.sort_values(by=['i', 'j']).reset_index(drop=True)
+        pandas.testing.assert_frame_equal(res, gold[['i', 'j', 'v']])
+
+        if url.startswith('s3://'):
+            sizes[compression_filter] = s3_con.head_object(
+                Bucket=s3_bucket,
+                Key='{}/{}/chunks/c_0_0'.format(
+                    base_prefix, prefix))['ContentLength']
+        elif url.startswith('file://'):
+            sizes[compression_filter] = os.path.getsize(
+                '{}/{}/chunks/c_0_0'.format(fs_base, prefix))
+
+    assert sizes['shuffle'] < sizes['none']
+
+    with pytest.raises(requests.exceptions.HTTPError):
+        scidb_con.iquery("""
+xsave(
+  build(<v:int64>[i=0:9], i),
+  '{}/compression_filter_error', compression:'zstd',
+  compression_filter:'shuffle')""".format(url))
+
+
+@pytest.mark.parametrize('url', test_urls)
+def test_compression_auto(scidb_con, url):
+    url = '{}/compression_auto'.format(url)
+    schema = '<v:int64, f:int64> [i=0:19:0:5; j=10:49:0:10]'
+
+    scidb_con.iquery("""
+xsave(
+  redimension(
+    apply(
+      build(<v:int64>[i=0:19:0:5; j=10:49:0:10], random()),
+      f, int64(1)),
+    {}),
+  '{}', compression:'auto')""".format(schema, url))
+
+    array = scidbbridge.Array(url)
+
+    # One codec per attribute and dimension, constant columns compress
+    codecs = array.metadata['compression_columns'].split(',')
+    assert array.metadata['compression'] == 'auto'
+    assert array.metadata['compression_layout'] == 'column'
+    assert len(codecs) == 4
+    assert codecs[1] != 'none'
+
+    values = array.get_chunk(5, 30).to_pandas()
+    assert (values['f'] == 1).all()
+    assert len(values) == 50
+
+    array = scidb_con.iquery(
+        "project(xinput('{}'), f)".format(url), fetch=True)
+    assert len(array) == 800
+    assert (array['f'] == 1).all()
+
+    # Updates use the recorded codecs
+    scidb_con.iquery("""
+xsave(
+  redimension(
+    apply(
+      build(<v:int64>[i=0:19:0:5; j=10:49:0:10], 0),
+      f, int64(0)),
+    {}),
+  '{}', update:true)""".format(schema, url))
+
+    array = scidbbridge.Array(url)
+    assert array.metadata['compression_columns'] == ','.join(codecs)
+    assert (array.get_chunk(5, 30).to_pandas()['f'] == 0).all()
+
+    with pytest.raises(requests.exceptions.HTTPError):
+        scidb_con.iquery("""
+xsave(
+  build({}, i + j),
+  '{}_error', compression:'auto', compression_layout:'stream')""".format(
+      '<v:int64>[i=0:19:0:5; j=10:49:0:10]', url))
+
+
 @pytest.mark.parametrize('url', (None,
                                  '',
                                  'foo',
@@ -551,6 +761,180 @@ xsave(
                          columns=('v', 'i', 'j')))
 
 
+@pytest.mark.parametrize('url', test_urls)
+def test_update_index_fence(scidb_con, url):
+    url = '{}/update_index_fence'.format(url)
+    schema = '<v:int64> [i=0:19:0:1; j=0:9:0:1]'
+
+    scidb_con.iquery("""
+xsave(
+  filter(
+    build({}, i),
+    i % 2 = 0),
+  '{}', index_split:100, index_format:'fence')""".format(schema, url))
+
+    array = scidbbridge.Array(url)
+
+    assert array.metadata == {**base_metadata,
+                              **{'schema': '{}'.format(schema),
+                                 'index_split': '100',
+                                 'index_format': 'fence'}}
+    pandas.testing.assert_frame_equal(
+        array.read_index(),
+        pandas.DataFrame(data=((i, j)
+                               for i in range(0, 20, 2)
+                               for j in range(10)),
+                         columns=('i', 'j')))
+
+    # Merge existing chunks and add new chunks
+    scidb_con.iquery("""
+xsave(
+  filter(
+    build({}, i + 1),
+    i < 10),
+  '{}', update:true)""".format(schema, url))
+
+    array = scidbbridge.Array(url)
+
+    assert array.metadata['index_format'] == 'fence'
+    assert len(list(scidbbridge.driver.Driver.list(url + '/index'))) > 1
+    pandas.testing.assert_frame_equal(
+        array.read_index(),
+        pandas.DataFrame(data=((i, j)
+                               for i in range(20)
+                               for j in range(10)
+                               if i < 10 or i % 2 == 0),
+                         columns=('i', 'j')))
+
+    array = scidb_con.iquery("xinput('{}')".format(url), fetch=True)
+    array = array.sort_values(by=['i', 'j']).reset_index(drop=True)
+    pandas.testing.assert_frame_equal(
+        array,
+        pandas.DataFrame(data=((i, j, float(i + 1 if i < 10 else i))
+                               for i in range(20)
+                               for j in range(10)
+                               if i < 10 or i % 2 == 0),
+                         columns=('i', 'j', 'v')))
+
+    # Look up chunks by position, including missing chunks
+    array = scidb_con.iquery(
+        "between(xinput('{}'), 10, 0, 11, 9)".format(url), fetch=True)
+    array = array.sort_values(by=['i', 'j']).reset_index(drop=True)
+    pandas.testing.assert_frame_equal(
+        array,
+        pandas.DataFrame(data=((10, j, 10.0) for j in range(10)),
+                         columns=('i', 'j', 'v')))
+
+    # Fence index cannot be partitioned
+    with pytest.raises(requests.exceptions.HTTPError):
+        scidb_con.iquery("""
+xsave(
+  build({}, i),
+  '{}_partition', index_format:'fence', index_partition:2)""".format(
+      schema, url))
+
+
+@pytest.mark.parametrize('url', test_urls)
+def test_update_chunk_fanout(scidb_con, url):
+    url = '{}/update_chunk_fanout'.format(url)
+    schema = '<v:int64> [i=0:19:0:1; j=0:9:0:5]'
+
+    scidb_con.iquery("""
+xsave(
+  filter(
+    build({}, i),
+    i % 2 = 0),
+  '{}', chunk_fanout:16)""".format(schema, url))
+
+    array = scidbbridge.Array(url)
+
+    assert array.metadata == {**base_metadata,
+                              **{'schema': '{}'.format(schema),
+                                 'chunk_fanout': '16'}}
+    chunks = list(scidbbridge.driver.Driver.list(url + '/chunks'))
+    assert len(chunks) == 20
+    for chunk in chunks:
+        assert chunk.split('/')[-2] in ['{:x}'.format(d) for d in range(16)]
+    pandas.testing.assert_frame_equal(
+        array.get_chunk(4, 5).to_pandas(),
+        pandas.DataFrame(data=((4, 4, j) for j in range(5, 10)),
+                         columns=('v', 'i', 'j')))
+
+    # New chunks use the same sub-directories
+    scidb_con.iquery("""
+xsave(
+  filter(
+    build({}, i + 1),
+    i < 10),
+  '{}', update:true)""".format(schema, url))
+
+    array = scidbbridge.Array(url)
+
+    assert array.metadata['chunk_fanout'] == '16'
+    pandas.testing.assert_frame_equal(
+        array.build_index(),
+        array.read_index())
+
+    array = scidb_con.iquery("xinput('{}')".format(url), fetch=True)
+    array = array.sort_values(by=['i', 'j']).reset_index(drop=True)
+    pandas.testing.assert_frame_equal(
+        array,
+        pandas.DataFrame(data=((i, j, float(i + 1 if i < 10 else i))
+                               for i in range(20)
+                               for j in range(10)
+                               if i < 10 or i % 2 == 0),
+                         columns=('i', 'j', 'v')))
+
+
+@pytest.mark.parametrize('url', test_urls)
+def test_pack_size(scidb_con, url):
+    url = '{}/pack_size'.format(url)
+    schema = '<v:int64> [i=0:19:0:1; j=0:9:0:5]'
+
+    scidb_con.iquery("""
+xsave(
+  filter(
+    build({}, i),
+    i % 2 = 0),
+  '{}', pack_size:1024, chunk_fanout:4)""".format(schema, url))
+
+    array = scidbbridge.Array(url)
+
+    assert array.metadata == {**base_metadata,
+                              **{'schema': '{}'.format(schema),
+                                 'chunk_fanout': '4',
+                                 'pack_size': '1024'}}
+    assert list(scidbbridge.driver.Driver.list(url + '/chunks')) == []
+    packs = list(scidbbridge.driver.Driver.list(url + '/packs'))
+    assert 0 < len(packs) < 20
+    pandas.testing.assert_frame_equal(
+        array.read_index(),
+        pandas.DataFrame(data=((i, j)
+                               for i in range(0, 20, 2)
+                               for j in range(0, 10, 5)),
+                         columns=('i', 'j')))
+    pandas.testing.assert_frame_equal(
+        array.get_chunk(4, 5).to_pandas(),
+        pandas.DataFrame(data=((4, 4, j) for j in range(5, 10)),
+                         columns=('v', 'i', 'j')))
+
+    array = scidb_con.iquery("xinput('{}')".format(url), fetch=True)
+    array = array.sort_values(by=['i', 'j']).reset_index(drop=True)
+    pandas.testing.assert_frame_equal(
+        array,
+        pandas.DataFrame(data=((i, j, float(i))
+                               for i in range(0, 20, 2)
+                               for j in range(10)),
+                         columns=('i', 'j', 'v')))
+
+    # Packed arrays cannot be updated
+    with pytest.raises(requests.exceptions.HTTPError):
+        scidb_con.iquery("""
+xsave(
+  build({}, i),
+  '{}', update:true)""".format(schema, url))
+
+
 @pytest.mark.parametrize(('url', 'ty', 'value'),
                          ((url, ty, value)
                           for url in test_urls
@@ -0,0 +1,105 @@
+/*
+**
+* BEGIN_COPYRIGHT
+*
+* Copyright (C) 2020-2021 Paradigm4 Inc.
+* All Rights Reserved.
+*
+* bridge is a plugin for SciDB, an Open Source Array DBMS maintained
+* by Paradigm4. See http://www.paradigm4.com/
+*
+* bridge is free software: you can redistribute it and/or modify
+* it under the terms of the AFFERO GNU General Public License as published by
+* the Free Software Foundation.
+*
+* bridge is distributed "AS-IS" AND WITHOUT ANY WARRANTY OF ANY KIND,
+* INCLUDING ANY IMPLIED WARRANTY OF MERCHANTABILITY,
+* NON-INFRINGEMENT, OR FITNESS FOR A PARTICULAR PURPOSE. See
+* the AFFERO GNU General Public License for the complete license terms.
+*
+* You should have received a copy of the AFFERO GNU General Public License
+* along with bridge.  If not, see <http://www.gnu.org/licenses/agpl-3.0.html>
+*
+* END_COPYRIGHT
+*/
+
+#include "AIMDLimit.h"
+
+#include <algorithm>
+
+
+namespace scidb {
+
+    AIMDLimit::AIMDLimit(double initLimit, double maxLimit):
+        _maxLimit(std::max(maxLimit, 1.0)),
+        _limit(std::min(std::max(initLimit, 1.0), std::max(maxLimit, 1.0))),
+        _classes()
+    {}
+
+    const char* AIMDLimit::update(bool success,
+                                  bool throttled,
+                                  std::chrono::microseconds latency,
+                                  size_t bytes,
+                                  Clock::time_point now)
+    {
+        SizeClass &sizeClass = _classes[getClass(bytes)];
+        double sample = latency.count();
+        const char *reason = NULL;
+
+        if (throttled) {
+            if (_decrease(sizeClass, now))
+                reason = "throttled";
+        }
+        else if (sizeClass.nSamples >= LIMITER_WARMUP
+                 && sample > LIMITER_SPIKE_FACTOR * sizeClass.latency) {
+            if (_decrease(sizeClass, now))
+                reason = "latency spike";
+        }
+        else if (success)
+            // Additive Increase, by one per window of requests
+            _limit = std::min(_maxLimit, _limit + 1 / _limit);
+
+        // Smooth latency of successful requests only, errors can
+        // return early
+        if (success) {
+            sizeClass.latency = sizeClass.nSamples == 0 ? sample :
+                (1 - LIMITER_SMOOTHING) * sizeClass.latency
+                + LIMITER_SMOOTHING * sample;
+            sizeClass.nSamples++;
+        }
+        return reason;
+    }
+
+    double AIMDLimit::getLimit() const
+    {
+        return _limit;
+    }
+
+    double AIMDLimit::getLatency(size_t bytes) const
+    {
+        return _classes[getClass(bytes)].latency;
+    }
+
+    size_t AIMDLimit::getClass(size_t bytes)
+    {
+        size_t result = 0;
+        for (bytes >>= LIMITER_CLASS_MIN;
+             bytes > 0 && result + 1 < LIMITER_CLASSES;
+             bytes >>= LIMITER_CLASS_STEP)
+            result++;
+        return result;
+    }
+
+    bool AIMDLimit::_decrease(const SizeClass &sizeClass, Clock::time_point now)
+    {
+        // Multiplicative Decrease, once per smoothed latency
+        if (now - _lastDecrease <
+            std::chrono::microseconds(static_cast<int64_t>(sizeClass.latency)))
+            return false;
+        _lastDecrease = now;
+
+        _limit = std::max(1.0, _limit / 2);
+        return true;
+    }
+
+} // namespace scidb
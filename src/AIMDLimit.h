@@ -0,0 +1,88 @@
+/*
+**
+* BEGIN_COPYRIGHT
+*
+* Copyright (C) 2020-2021 Paradigm4 Inc.
+* All Rights Reserved.
+*
+* bridge is a plugin for SciDB, an Open Source Array DBMS maintained
+* by Paradigm4. See http://www.paradigm4.com/
+*
+* bridge is free software: you can redistribute it and/or modify
+* it under the terms of the AFFERO GNU General Public License as published by
+* the Free Software Foundation.
+*
+* bridge is distributed "AS-IS" AND WITHOUT ANY WARRANTY OF ANY KIND,
+* INCLUDING ANY IMPLIED WARRANTY OF MERCHANTABILITY,
+* NON-INFRINGEMENT, OR FITNESS FOR A PARTICULAR PURPOSE. See
+* the AFFERO GNU General Public License for the complete license terms.
+*
+* You should have received a copy of the AFFERO GNU General Public License
+* along with bridge.  If not, see <http://www.gnu.org/licenses/agpl-3.0.html>
+*
+* END_COPYRIGHT
+*/
+
+#ifndef AIMD_LIMIT_H_
+#define AIMD_LIMIT_H_
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+
+
+#define LIMITER_SPIKE_FACTOR 3.0
+#define LIMITER_SMOOTHING 0.05    // weight of the last latency
+#define LIMITER_WARMUP 20         // requests before detecting spikes
+#define LIMITER_CLASSES 3         // size classes, see getClass
+#define LIMITER_CLASS_MIN 20      // log2 of the first class bound, 1MB
+#define LIMITER_CLASS_STEP 4      // log2 of the ratio between bounds
+
+
+namespace scidb {
+
+// Arithmetic of the adaptive (AIMD) limit on the number of in-flight
+// requests, see S3Limiter. Not thread-safe. Latencies are smoothed
+// and spikes are detected per size class, so a large transfer is not
+// taken for a spike of the small requests.
+class AIMDLimit {
+public:
+    typedef std::chrono::steady_clock Clock;
+
+    AIMDLimit(double initLimit, double maxLimit);
+
+    // Adjust the limit based on the outcome, latency, and bytes
+    // transferred by a request. Returns the reason if the limit was
+    // decreased, NULL otherwise.
+    const char* update(bool success,
+                       bool throttled,
+                       std::chrono::microseconds,
+                       size_t bytes,
+                       Clock::time_point now);
+
+    double getLimit() const;
+
+    // Smoothed latency of the size class of bytes, in microseconds
+    double getLatency(size_t bytes) const;
+
+    // Size class of a request, smaller than 1MB, smaller than 16MB,
+    // or larger
+    static size_t getClass(size_t bytes);
+
+private:
+    struct SizeClass {
+        double latency;         // Smoothed, in microseconds
+        size_t nSamples;
+    };
+
+    const double _maxLimit;
+    double _limit;
+    SizeClass _classes[LIMITER_CLASSES];
+    Clock::time_point _lastDecrease;
+
+    bool _decrease(const SizeClass&, Clock::time_point now);
+};
+
+} // namespace scidb
+
+#endif  // AIMD_LIMIT_H_
@@ -0,0 +1,162 @@
+/*
+**
+* BEGIN_COPYRIGHT
+*
+* Copyright (C) 2020-2021 Paradigm4 Inc.
+* All Rights Reserved.
+*
+* bridge is a plugin for SciDB, an Open Source Array DBMS maintained
+* by Paradigm4. See http://www.paradigm4.com/
+*
+* bridge is free software: you can redistribute it and/or modify
+* it under the terms of the AFFERO GNU General Public License as published by
+* the Free Software Foundation.
+*
+* bridge is distributed "AS-IS" AND WITHOUT ANY WARRANTY OF ANY KIND,
+* INCLUDING ANY IMPLIED WARRANTY OF MERCHANTABILITY,
+* NON-INFRINGEMENT, OR FITNESS FOR A PARTICULAR PURPOSE. See
+* the AFFERO GNU General Public License for the complete license terms.
+*
+* You should have received a copy of the AFFERO GNU General Public License
+* along with bridge.  If not, see <http://www.gnu.org/licenses/agpl-3.0.html>
+*
+* END_COPYRIGHT
+*/
+
+#include "Config.h"
+
+#include <cstdlib>
+#include <fstream>
+#include <sstream>
+
+// SciDB
+#include <system/UserException.h>
+
+
+#define FAIL(reason, path, value)                                               \
+    {                                                                           \
+        std::ostringstream out;                                                 \
+        out << (reason) << " '" << (value) << "' in " << (path);                \
+        throw USER_EXCEPTION(SCIDB_SE_METADATA, SCIDB_LE_ILLEGAL_OPERATION)     \
+            << out.str();                                                       \
+    }
+
+
+namespace scidb {
+
+// Remove leading and trailing white space
+static std::string trim(const std::string &value) {
+    const char *space = " \t\r";
+    size_t begin = value.find_first_not_of(space);
+    if (begin == std::string::npos)
+        return "";
+    return value.substr(begin, value.find_last_not_of(space) - begin + 1);
+}
+
+std::shared_ptr<const Config> Config::read() {
+    auto config = std::make_shared<Config>();
+
+    const char *env = std::getenv(CONFIG_ENV);
+    if (env != NULL)
+        config->_path = env;
+    else {
+        const char *home = std::getenv("HOME");
+        if (home == NULL)
+            return config;
+        config->_path = std::string(home) + "/" + CONFIG_PATH;
+    }
+
+    std::ifstream stream(config->_path);
+    if (stream.fail())
+        return config;
+
+    std::string line;
+    while (std::getline(stream, line)) {
+        line = trim(line);
+        if (line.empty() || line[0] == '#')
+            continue;
+
+        size_t pos = line.find('=');
+        if (pos == std::string::npos)
+            FAIL("Invalid line", config->_path, line);
+
+        config->_values[trim(line.substr(0, pos))] = trim(line.substr(pos + 1));
+    }
+
+    return config;
+}
+
+std::string Config::getString(const std::string &key,
+                              const std::string &defaultValue) const {
+    auto valuePair = _values.find(key);
+    return valuePair == _values.end() ? defaultValue : valuePair->second;
+}
+
+int64_t Config::getInt(const std::string &key, int64_t defaultValue) const {
+    auto valuePair = _values.find(key);
+    if (valuePair == _values.end())
+        return defaultValue;
+
+    try {
+        size_t pos;
+        int64_t value = std::stoll(valuePair->second, &pos);
+        if (pos == valuePair->second.size())
+            return value;
+    }
+    catch (const std::exception &ex) {}
+    FAIL("Invalid value for key " + key, _path, valuePair->second);
+}
+
+size_t Config::getSize(const std::string &key,
+                       size_t defaultValue,
+                       size_t min,
+                       size_t max) const {
+    auto valuePair = _values.find(key);
+    if (valuePair == _values.end())
+        return defaultValue;
+
+    // stoull accepts, and negates, a leading minus sign
+    const std::string &text = valuePair->second;
+    try {
+        size_t pos;
+        if (text.find('-') == std::string::npos) {
+            unsigned long long value = std::stoull(text, &pos);
+            if (pos == text.size() && value >= min && value <= max)
+                return value;
+        }
+    }
+    catch (const std::exception &ex) {}
+    std::ostringstream reason;
+    reason << "Invalid value for key " << key
+           << ", must be between " << min << " and " << max << ",";
+    FAIL(reason.str(), _path, text);
+}
+
+double Config::getDouble(const std::string &key, double defaultValue) const {
+    auto valuePair = _values.find(key);
+    if (valuePair == _values.end())
+        return defaultValue;
+
+    try {
+        size_t pos;
+        double value = std::stod(valuePair->second, &pos);
+        if (pos == valuePair->second.size())
+            return value;
+    }
+    catch (const std::exception &ex) {}
+    FAIL("Invalid value for key " + key, _path, valuePair->second);
+}
+
+bool Config::getBool(const std::string &key, bool defaultValue) const {
+    auto valuePair = _values.find(key);
+    if (valuePair == _values.end())
+        return defaultValue;
+
+    if (valuePair->second == "true")
+        return true;
+    if (valuePair->second == "false")
+        return false;
+    FAIL("Invalid value for key " + key, _path, valuePair->second);
+}
+
+} // namespace scidb
@@ -0,0 +1,70 @@
+/*
+**
+* BEGIN_COPYRIGHT
+*
+* Copyright (C) 2020-2021 Paradigm4 Inc.
+* All Rights Reserved.
+*
+* bridge is a plugin for SciDB, an Open Source Array DBMS maintained
+* by Paradigm4. See http://www.paradigm4.com/
+*
+* bridge is free software: you can redistribute it and/or modify
+* it under the terms of the AFFERO GNU General Public License as published by
+* the Free Software Foundation.
+*
+* bridge is distributed "AS-IS" AND WITHOUT ANY WARRANTY OF ANY KIND,
+* INCLUDING ANY IMPLIED WARRANTY OF MERCHANTABILITY,
+* NON-INFRINGEMENT, OR FITNESS FOR A PARTICULAR PURPOSE. See
+* the AFFERO GNU General Public License for the complete license terms.
+*
+* You should have received a copy of the AFFERO GNU General Public License
+* along with bridge.  If not, see <http://www.gnu.org/licenses/agpl-3.0.html>
+*
+* END_COPYRIGHT
+*/
+
+#ifndef CONFIG_H_
+#define CONFIG_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <string>
+
+
+#define CONFIG_ENV "SCIDB_BRIDGE_CONFIG"
+#define CONFIG_PATH ".config/scidb/bridge.conf" // Relative to $HOME
+
+
+namespace scidb {
+
+// Bridge configuration file with "key = value" lines. Empty lines and
+// lines starting with "#" are ignored. The file is read from the path
+// in the SCIDB_BRIDGE_CONFIG environment variable, if set, or from
+// $HOME/.config/scidb/bridge.conf. A missing file is an empty
+// configuration.
+class Config {
+public:
+    static std::shared_ptr<const Config> read();
+
+    std::string getString(const std::string &key,
+                          const std::string &defaultValue) const;
+    int64_t getInt(const std::string &key, int64_t defaultValue) const;
+
+    // Sizes and counts are rejected if they are outside [min, max]
+    size_t getSize(const std::string &key,
+                   size_t defaultValue,
+                   size_t min=0,
+                   size_t max=SIZE_MAX) const;
+    double getDouble(const std::string &key, double defaultValue) const;
+    bool getBool(const std::string &key, bool defaultValue) const;
+
+private:
+    std::string _path;
+    std::map<std::string, std::string> _values;
+};
+
+} // namespace scidb
+
+#endif  // Config
@@ -23,9 +23,14 @@
 * END_COPYRIGHT
 */
 
+#include "Config.h"
 #include "S3Driver.h"
 #include "FSDriver.h"
 
+#include <algorithm>
+#include <cstdint>
+#include <iomanip>
+
 // SciDB
 #include <query/LogicalQueryPlan.h>
 #include <query/Parser.h>
@@ -92,18 +97,20 @@ void Metadata::setSchema(const ArrayDesc &schema) {
     _metadata["schema"] = out.str();
 }
 
-Metadata::Compression Metadata::getCompression() const {
-    auto compressionPair = _metadata.find("compression");
-    if (compressionPair == _metadata.end())
-        throw SYSTEM_EXCEPTION(scidb::SCIDB_SE_METADATA,
-                               scidb::SCIDB_LE_UNKNOWN_ERROR)
-            << "Compression missing from metadata";
-
-    auto compression = compressionPair->second;
+// Codec name as recorded in the metadata
+static Metadata::Compression parseCompression(const std::string &compression) {
     if (compression == "none")
         return Metadata::Compression::NONE;
     else if (compression == "gzip")
         return Metadata::Compression::GZIP;
+    else if (compression == "zstd")
+        return Metadata::Compression::ZSTD;
+    else if (compression == "lz4")
+        return Metadata::Compression::LZ4;
+    else if (compression == "snappy")
+        return Metadata::Compression::SNAPPY;
+    else if (compression == "auto")
+        return Metadata::Compression::AUTO;
     else {
         std::ostringstream error;
         error << "Unsupported compression '" << compression << "'";
@@ -112,17 +119,20 @@ Metadata::Compression Metadata::getCompression() const {
     }
 }
 
-void Metadata::setCompression(Metadata::Compression compression) {
-    std::string compressionStr;
+static std::string compressionName(Metadata::Compression compression) {
     switch (compression) {
-    case Metadata::Compression::NONE: {
-        compressionStr = "none";
-        break;
-    }
-    case Metadata::Compression::GZIP: {
-        compressionStr = "gzip";
-        break;
-    }
+    case Metadata::Compression::NONE:
+        return "none";
+    case Metadata::Compression::GZIP:
+        return "gzip";
+    case Metadata::Compression::ZSTD:
+        return "zstd";
+    case Metadata::Compression::LZ4:
+        return "lz4";
+    case Metadata::Compression::SNAPPY:
+        return "snappy";
+    case Metadata::Compression::AUTO:
+        return "auto";
     default: {
         std::ostringstream error;
         error << "Unsupported compression '" << compression << "'";
@@ -130,7 +140,266 @@ void Metadata::setCompression(Metadata::Compression compression) {
             << error.str();
     }
     }
-    _metadata["compression"] = compressionStr;
+}
+
+Metadata::Compression Metadata::getCompression() const {
+    auto compressionPair = _metadata.find("compression");
+    if (compressionPair == _metadata.end())
+        throw SYSTEM_EXCEPTION(scidb::SCIDB_SE_METADATA,
+                               scidb::SCIDB_LE_UNKNOWN_ERROR)
+            << "Compression missing from metadata";
+
+    return parseCompression(compressionPair->second);
+}
+
+void Metadata::setCompression(Metadata::Compression compression) {
+    _metadata["compression"] = compressionName(compression);
+}
+
+int Metadata::getCompressionLevel() const {
+    auto levelPair = _metadata.find("compression_level");
+    if (levelPair == _metadata.end())
+        return COMPRESSION_LEVEL_DEFAULT;
+
+    auto value = levelPair->second;
+    try {
+        return std::stoi(value);
+    }
+    catch (const std::exception &ex) {
+        std::ostringstream error;
+        error << "Cannot parse value '" << value
+              << "' for key 'compression_level'";
+        throw SYSTEM_EXCEPTION(SCIDB_SE_METADATA, SCIDB_LE_ILLEGAL_OPERATION)
+            << error.str();
+    }
+}
+
+void Metadata::setCompressionLevel(int compressionLevel) {
+    if (compressionLevel != COMPRESSION_LEVEL_DEFAULT)
+        _metadata["compression_level"] = std::to_string(compressionLevel);
+    else
+        _metadata.erase("compression_level");
+}
+
+Metadata::CompressionLayout Metadata::getCompressionLayout() const {
+    auto layoutPair = _metadata.find("compression_layout");
+    if (layoutPair == _metadata.end())
+        return Metadata::CompressionLayout::LAYOUT_STREAM;
+
+    auto layout = layoutPair->second;
+    if (layout == "stream")
+        return Metadata::CompressionLayout::LAYOUT_STREAM;
+    else if (layout == "column")
+        return Metadata::CompressionLayout::LAYOUT_COLUMN;
+    else {
+        std::ostringstream error;
+        error << "Value '" << layout
+              << "' for key 'compression_layout' not supported";
+        throw SYSTEM_EXCEPTION(SCIDB_SE_METADATA, SCIDB_LE_ILLEGAL_OPERATION)
+            << error.str();
+    }
+}
+
+void Metadata::setCompressionLayout(Metadata::CompressionLayout compressionLayout) {
+    if (compressionLayout == Metadata::CompressionLayout::LAYOUT_COLUMN)
+        _metadata["compression_layout"] = "column";
+    else
+        _metadata.erase("compression_layout");
+}
+
+Metadata::CompressionFilter Metadata::getCompressionFilter() const {
+    auto filterPair = _metadata.find("compression_filter");
+    if (filterPair == _metadata.end())
+        return Metadata::CompressionFilter::FILTER_NONE;
+
+    auto filter = filterPair->second;
+    if (filter == "none")
+        return Metadata::CompressionFilter::FILTER_NONE;
+    else if (filter == "shuffle")
+        return Metadata::CompressionFilter::FILTER_SHUFFLE;
+    else if (filter == "bitshuffle")
+        return Metadata::CompressionFilter::FILTER_BITSHUFFLE;
+    else {
+        std::ostringstream error;
+        error << "Value '" << filter
+              << "' for key 'compression_filter' not supported";
+        throw SYSTEM_EXCEPTION(SCIDB_SE_METADATA, SCIDB_LE_ILLEGAL_OPERATION)
+            << error.str();
+    }
+}
+
+void Metadata::setCompressionFilter(Metadata::CompressionFilter compressionFilter) {
+    switch (compressionFilter) {
+    case Metadata::CompressionFilter::FILTER_SHUFFLE:
+        _metadata["compression_filter"] = "shuffle";
+        break;
+    case Metadata::CompressionFilter::FILTER_BITSHUFFLE:
+        _metadata["compression_filter"] = "bitshuffle";
+        break;
+    default:
+        _metadata.erase("compression_filter");
+    }
+}
+
+std::vector<Metadata::ColumnCompression> Metadata::getColumnCompression() const {
+    std::vector<Metadata::ColumnCompression> columns;
+    auto columnsPair = _metadata.find("compression_columns");
+    if (columnsPair == _metadata.end())
+        return columns;
+
+    // Comma separated codecs, each optionally followed by ":level"
+    std::istringstream stream(columnsPair->second);
+    std::string value;
+    while (std::getline(stream, value, ',')) {
+        try {
+            auto sep = value.find(':');
+            Metadata::ColumnCompression column{
+                parseCompression(value.substr(0, sep)),
+                COMPRESSION_LEVEL_DEFAULT};
+            if (sep != std::string::npos) {
+                size_t pos;
+                column.level = std::stoi(value.substr(sep + 1), &pos);
+                if (pos != value.size() - sep - 1)
+                    throw std::invalid_argument(value);
+            }
+            if (column.compression == Metadata::Compression::AUTO)
+                throw std::invalid_argument(value);
+            columns.push_back(column);
+        }
+        catch (const std::exception &ex) {
+            std::ostringstream error;
+            error << "Cannot parse value '" << columnsPair->second
+                  << "' for key 'compression_columns'";
+            throw SYSTEM_EXCEPTION(SCIDB_SE_METADATA,
+                                   SCIDB_LE_ILLEGAL_OPERATION)
+                << error.str();
+        }
+    }
+    return columns;
+}
+
+void Metadata::setColumnCompression(
+    const std::vector<Metadata::ColumnCompression> &columns) {
+    std::ostringstream out;
+    for (size_t i = 0; i < columns.size(); ++i) {
+        out << (i == 0 ? "" : ",") << compressionName(columns[i].compression);
+        if (columns[i].level != COMPRESSION_LEVEL_DEFAULT)
+            out << ":" << columns[i].level;
+    }
+    _metadata["compression_columns"] = out.str();
+}
+
+Metadata::IndexFormat Metadata::getIndexFormat() const {
+    auto formatPair = _metadata.find("index_format");
+    if (formatPair == _metadata.end())
+        return Metadata::IndexFormat::INDEX_ARROW;
+
+    auto format = formatPair->second;
+    if (format == "arrow")
+        return Metadata::IndexFormat::INDEX_ARROW;
+    else if (format == "fence")
+        return Metadata::IndexFormat::INDEX_FENCE;
+    else {
+        std::ostringstream error;
+        error << "Value '" << format
+              << "' for key 'index_format' not supported";
+        throw SYSTEM_EXCEPTION(SCIDB_SE_METADATA, SCIDB_LE_ILLEGAL_OPERATION)
+            << error.str();
+    }
+}
+
+void Metadata::setIndexFormat(Metadata::IndexFormat indexFormat) {
+    if (indexFormat == Metadata::IndexFormat::INDEX_FENCE)
+        _metadata["index_format"] = "fence";
+    else
+        _metadata.erase("index_format");
+}
+
+size_t Metadata::getIndexPartition() const {
+    return _getSizeKey("index_partition", 1, SIZE_MAX);
+}
+
+std::vector<size_t> Metadata::getIndexPartitionSplit() const {
+    std::vector<size_t> split;
+    auto splitPair = _metadata.find("index_partition_split");
+    if (splitPair == _metadata.end())
+        return split;
+
+    std::istringstream stream(splitPair->second);
+    std::string value;
+    while (std::getline(stream, value, ',')) {
+        try {
+            size_t pos;
+            split.push_back(std::stoull(value, &pos));
+            if (pos != value.size() || (split.size() > 1 &&
+                                        split.back() < split[split.size() - 2]))
+                throw std::invalid_argument(value);
+        }
+        catch (const std::exception &ex) {
+            std::ostringstream error;
+            error << "Cannot parse value '" << splitPair->second
+                  << "' for key 'index_partition_split'";
+            throw SYSTEM_EXCEPTION(SCIDB_SE_METADATA,
+                                   SCIDB_LE_ILLEGAL_OPERATION)
+                << error.str();
+        }
+    }
+    return split;
+}
+
+void Metadata::setIndexPartition(size_t nPart,
+                                 const std::vector<size_t> &split) {
+    std::ostringstream out;
+    for (size_t i = 0; i < split.size(); ++i)
+        out << (i == 0 ? "" : ",") << split[i];
+    _metadata["index_partition"] = std::to_string(nPart);
+    _metadata["index_partition_split"] = out.str();
+}
+
+size_t Metadata::getChunkFanout() const {
+    return _getSizeKey("chunk_fanout", 1, CHUNK_FANOUT_MAX);
+}
+
+void Metadata::setChunkFanout(size_t chunkFanout) {
+    if (chunkFanout > 0)
+        _metadata["chunk_fanout"] = std::to_string(chunkFanout);
+    else
+        _metadata.erase("chunk_fanout");
+}
+
+size_t Metadata::getPackSize() const {
+    return _getSizeKey("pack_size", 1, CHUNK_MAX_SIZE);
+}
+
+void Metadata::setPackSize(size_t packSize) {
+    if (packSize > 0)
+        _metadata["pack_size"] = std::to_string(packSize);
+    else
+        _metadata.erase("pack_size");
+}
+
+size_t Metadata::_getSizeKey(const std::string &key,
+                             size_t min,
+                             size_t max) const {
+    auto valuePair = _metadata.find(key);
+    if (valuePair == _metadata.end())
+        return 0;
+
+    auto value = valuePair->second;
+    try {
+        size_t pos;
+        long long value_num = std::stoll(value, &pos);
+        if (pos == value.size()
+            && value_num >= 0
+            && static_cast<unsigned long long>(value_num) >= min
+            && static_cast<unsigned long long>(value_num) <= max)
+            return value_num;
+    }
+    catch (const std::exception &ex) {}
+    std::ostringstream error;
+    error << "Cannot parse value '" << value << "' for key '" << key << "'";
+    throw SYSTEM_EXCEPTION(SCIDB_SE_METADATA, SCIDB_LE_ILLEGAL_OPERATION)
+        << error.str();
 }
 
 void Metadata::validate() const {
@@ -200,9 +469,85 @@ void Metadata::validate() const {
             << error.str();
     }
 
-    // Check compression
+    // Check compression and compression_level, if present
     // Throws Exception If Not Supported
     getCompression();
+    getCompressionLevel();
+    getCompressionLayout();
+
+    // Check compression_columns, written for compression auto
+    if (getCompression() == Compression::AUTO
+        && (getCompressionLayout() != CompressionLayout::LAYOUT_COLUMN
+            || getColumnCompression().empty())) {
+        std::ostringstream error;
+        error << "Compression 'auto' requires keys 'compression_layout' "
+              << "and 'compression_columns'";
+        throw SYSTEM_EXCEPTION(SCIDB_SE_METADATA, SCIDB_LE_ILLEGAL_OPERATION)
+            << error.str();
+    }
+
+    // Check compression_filter, only used by the column layout
+    if (getCompressionFilter() != CompressionFilter::FILTER_NONE
+        && getCompressionLayout() != CompressionLayout::LAYOUT_COLUMN) {
+        std::ostringstream error;
+        error << "Key 'compression_filter' requires column "
+              << "'compression_layout'";
+        throw SYSTEM_EXCEPTION(SCIDB_SE_METADATA, SCIDB_LE_ILLEGAL_OPERATION)
+            << error.str();
+    }
+
+    // Check index_format, if present
+    // Throws Exception If Not Supported
+    getIndexFormat();
+
+    // Check index_partition and index_partition_split, if present
+    // Both keys are written together
+    size_t nPart = getIndexPartition();
+    if (nPart > 0 && getIndexPartitionSplit().size() != nPart + 1) {
+        std::ostringstream error;
+        error << "Value '" << _metadata.at("index_partition")
+              << "' for key 'index_partition' does not match "
+              << "key 'index_partition_split'";
+        throw SYSTEM_EXCEPTION(SCIDB_SE_METADATA, SCIDB_LE_ILLEGAL_OPERATION)
+            << error.str();
+    }
+
+    // Check chunk_fanout, if present
+    // Throws Exception If Not Supported
+    getChunkFanout();
+
+    // Check pack_size, if present
+    // Throws Exception If Not Supported
+    if (getPackSize() > 0 && getIndexFormat() == IndexFormat::INDEX_FENCE) {
+        std::ostringstream error;
+        error << "Key 'pack_size' not supported with fence index";
+        throw SYSTEM_EXCEPTION(SCIDB_SE_METADATA, SCIDB_LE_ILLEGAL_OPERATION)
+            << error.str();
+    }
+}
+
+std::string Metadata::serialize() const {
+    std::ostringstream out;
+    for (auto i = _metadata.begin(); i != _metadata.end(); ++i)
+        out << i->first << "\t" << i->second << "\n";
+    return out.str();
+}
+
+void Metadata::deserialize(const std::string &input) {
+    std::istringstream stream(input);
+    std::string line;
+    while (std::getline(stream, line)) {
+        std::istringstream lineStream(line);
+        std::string key, value;
+        if (!std::getline(lineStream, key, '\t')
+            || !std::getline(lineStream, value)) {
+            std::ostringstream out;
+            out << "Invalid metadata line '" << line << "'";
+            throw SYSTEM_EXCEPTION(SCIDB_SE_METADATA, SCIDB_LE_UNKNOWN_ERROR)
+                << out.str();
+        }
+        _metadata[key] = value;
+    }
 }
 
 std::string Metadata::coord2ObjectName(const Coordinates &pos,
@@ -215,6 +560,260 @@ std::string Metadata::coord2ObjectName(const Coordinates &pos,
     return out.str();
 }
 
+// MurmurHash3 x86 32-bit, by Austin Appleby (public domain). Used to
+// spread chunk objects over sub-directories. Readers in other
+// languages (e.g., the Python package) use the same function, so it
+// must not change.
+static uint32_t murmurHash3(const std::string &key, uint32_t seed) {
+    const uint8_t *data = reinterpret_cast<const uint8_t*>(key.data());
+    const size_t len = key.size();
+    const size_t nBlocks = len / 4;
+    const uint32_t c1 = 0xcc9e2d51, c2 = 0x1b873593;
+    uint32_t h = seed;
+
+    auto rotl = [](uint32_t x, int r) { return (x << r) | (x >> (32 - r)); };
+
+    // Body
+    for (size_t i = 0; i < nBlocks; ++i) {
+        uint32_t k = (uint32_t(data[i * 4])
+                      | uint32_t(data[i * 4 + 1]) << 8
+                      | uint32_t(data[i * 4 + 2]) << 16
+                      | uint32_t(data[i * 4 + 3]) << 24);
+        k *= c1;
+        k = rotl(k, 15);
+        k *= c2;
+        h ^= k;
+        h = rotl(h, 13);
+        h = h * 5 + 0xe6546b64;
+    }
+
+    // Tail
+    const uint8_t *tail = data + nBlocks * 4;
+    uint32_t k = 0;
+    switch (len & 3) {
+    case 3: k ^= uint32_t(tail[2]) << 16;  // Fall through
+    case 2: k ^= uint32_t(tail[1]) << 8;   // Fall through
+    case 1: k ^= tail[0];
+        k *= c1;
+        k = rotl(k, 15);
+        k *= c2;
+        h ^= k;
+    }
+
+    // Finalization
+    h ^= len;
+    h ^= h >> 16;
+    h *= 0x85ebca6b;
+    h ^= h >> 13;
+    h *= 0xc2b2ae35;
+    h ^= h >> 16;
+    return h;
+}
+
+// Prefix the object name with its hashed sub-directory, if any
+static std::string fanoutObjectName(const std::string &directory,
+                                    const std::string &name,
+                                    size_t chunkFanout) {
+    if (chunkFanout == 0)
+        return directory + "/" + name;
+
+    // Sub-directory names are zero-padded hex numbers, as wide as
+    // the largest one
+    size_t width = 1;
+    for (size_t max = chunkFanout - 1; max >= 16; max /= 16)
+        ++width;
+
+    std::ostringstream out;
+    out << directory << "/" << std::hex << std::setfill('0')
+        << std::setw(width) << murmurHash3(name, 0) % chunkFanout
+        << "/" << name;
+    return out.str();
+}
+
+std::string Metadata::chunkObjectName(const Coordinates &pos,
+                                      const Dimensions &dims,
+                                      size_t chunkFanout) {
+    return fanoutObjectName("chunks", coord2ObjectName(pos, dims), chunkFanout);
+}
+
+std::string Metadata::packObjectName(int64_t packID, size_t chunkFanout) {
+    return fanoutObjectName("packs", "p_" + std::to_string(packID), chunkFanout);
+}
+
+//
+// DriverPool
+//
+DriverPool& DriverPool::getInstance() {
+    // An invalid setting throws before the pool is created, the next
+    // request reads the configuration again
+    static DriverPool instance(
+        Config::read()->getSize("driver_threads",
+                                DRIVER_THREADS_DEFAULT,
+                                1,
+                                DRIVER_THREADS_MAX));
+    return instance;
+}
+
+DriverPool::DriverPool(size_t nThreads):
+    _stop(false)
+{
+    for (size_t i = 0; i < nThreads; ++i)
+        _threads.emplace_back(&DriverPool::_run, this);
+}
+
+DriverPool::~DriverPool() {
+    {
+        std::lock_guard<std::mutex> lock(_lock);
+        _stop = true;
+    }
+    _cond.notify_all();
+    for (auto &thread : _threads)
+        thread.join();
+}
+
+void DriverPool::_enqueue(std::function<void()> task) {
+    {
+        std::lock_guard<std::mutex> lock(_lock);
+        _tasks.push_back(std::move(task));
+    }
+    _cond.notify_one();
+}
+
+void DriverPool::_run() {
+    while (true) {
+        std::function<void()> task;
+        {
+            std::unique_lock<std::mutex> lock(_lock);
+            _cond.wait(lock, [this]() { return _stop || !_tasks.empty(); });
+            if (_tasks.empty())
+                return;
+            task = std::move(_tasks.front());
+            _tasks.pop_front();
+        }
+        // Exceptions are stored in the task future
+        task();
+    }
+}
+
+//
+// Driver
+//
+std::future<std::shared_ptr<arrow::Buffer> > Driver::readArrowAsync(
+    const std::string &suffix) const {
+    auto driver = shared_from_this();
+    return DriverPool::getInstance().submit<std::shared_ptr<arrow::Buffer> >(
+        [driver, suffix]() {
+            std::shared_ptr<arrow::Buffer> buffer;
+            driver->readArrow(suffix, buffer);
+            return buffer;
+        });
+}
+
+std::future<void> Driver::writeArrowAsync(
+    const std::string &suffix,
+    std::shared_ptr<const arrow::Buffer> buffer) const {
+    auto driver = shared_from_this();
+    return DriverPool::getInstance().submit<void>(
+        [driver, suffix, buffer]() {
+            driver->writeArrow(suffix, buffer);
+        });
+}
+
+// Wait for all the futures, re-throw the first failure
+template <typename Future, typename Get>
+static void waitAll(std::vector<Future> &futures, Get get) {
+    std::exception_ptr exception;
+    for (auto &future : futures)
+        try {
+            get(future);
+        }
+        catch (...) {
+            if (!exception)
+                exception = std::current_exception();
+        }
+    if (exception)
+        std::rethrow_exception(exception);
+}
+
+std::vector<std::shared_ptr<arrow::Buffer> > Driver::readMany(
+    const std::vector<std::string> &suffixes) const {
+    std::vector<std::future<std::shared_ptr<arrow::Buffer> > > futures;
+    for (auto &suffix : suffixes)
+        futures.push_back(readArrowAsync(suffix));
+
+    std::vector<std::shared_ptr<arrow::Buffer> > buffers;
+    waitAll(futures,
+            [&buffers](std::future<std::shared_ptr<arrow::Buffer> > &future) {
+                buffers.push_back(future.get());
+            });
+    return buffers;
+}
+
+void Driver::writeMany(
+    const std::vector<std::pair<std::string,
+                                std::shared_ptr<const arrow::Buffer> > > &objects) const {
+    std::vector<std::future<void> > futures;
+    for (auto &object : objects)
+        futures.push_back(writeArrowAsync(object.first, object.second));
+
+    waitAll(futures, [](std::future<void> &future) { future.get(); });
+}
+
+void Driver::readEach(
+    const std::vector<std::string> &suffixes,
+    size_t maxPending,
+    const std::function<void(size_t,
+                             std::shared_ptr<arrow::Buffer>)> &process) const {
+    std::deque<std::future<std::shared_ptr<arrow::Buffer> > > pending;
+    size_t next = 0;
+    for (size_t i = 0; i < suffixes.size(); ++i) {
+        while (next < suffixes.size() && pending.size() < maxPending)
+            pending.push_back(readArrowAsync(suffixes[next++]));
+
+        auto buffer = pending.front().get();
+        pending.pop_front();
+        process(i, buffer);
+    }
+}
+
+//
+// DriverWriteQueue
+//
+DriverWriteQueue::DriverWriteQueue(std::shared_ptr<const Driver> driver,
+                                   size_t maxPending):
+    _driver(driver),
+    _maxPending(std::max<size_t>(maxPending, 1))
+{}
+
+void DriverWriteQueue::write(const std::string &suffix,
+                             std::shared_ptr<const arrow::Buffer> buffer) {
+    if (_pending.size() >= _maxPending) {
+        auto future = std::move(_pending.front());
+        _pending.pop_front();
+        future.get();
+    }
+    _pending.push_back(_driver->writeArrowAsync(suffix, buffer));
+}
+
+void DriverWriteQueue::wait() {
+    std::vector<std::future<void> > futures;
+    for (auto &future : _pending)
+        futures.push_back(std::move(future));
+    _pending.clear();
+
+    waitAll(futures, [](std::future<void> &future) { future.get(); });
+}
+
+std::string Driver::_digestETag(const std::string &stamps) {
+    // 128 bits from four seeds, with the length of the stamps
+    std::ostringstream out;
+    out << std::hex << std::setfill('0');
+    for (uint32_t seed = 0; seed < 4; ++seed)
+        out << std::setw(8) << murmurHash3(stamps, seed);
+    out << "-" << stamps.size();
+    return out.str();
+}
+
 std::shared_ptr<Driver> Driver::makeDriver(const std::string url,
                                            const Driver::Mode mode)
 {
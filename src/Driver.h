@@ -26,9 +26,17 @@
 #ifndef DRIVER_H_
 #define DRIVER_H_
 
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <future>
+#include <limits>
 #include <map>
 #include <memory>
+#include <mutex>
 #include <sstream>
+#include <thread>
+#include <vector>
 
 // SciDB
 #include <array/ArrayDesc.h>
@@ -44,8 +52,22 @@
 #define INDEX_SPLIT_DEFAULT 100000  // Number of Coordinates =
                                     // (Number-of-Chunks *
                                     // Number-of-Dimensions)
+#define INDEX_FENCE_PAGE_SIZE 65536 // Bytes
 #define CACHE_SIZE_DEFAULT 268435456 // 256MB in Bytes
 #define CHUNK_MAX_SIZE 2147483648
+#define DRIVER_THREADS_DEFAULT 16
+#define DRIVER_THREADS_MAX 1024
+#define DRIVER_PENDING_DEFAULT 8    // Outstanding requests per caller
+#define CHUNK_FANOUT_MAX 65536      // Chunk sub-directories
+#define COMPRESSION_LEVEL_DEFAULT std::numeric_limits<int>::min() // Codec default
+#define PACK_GAP_MAX 1048576        // Bytes, largest gap read to coalesce
+                                    // packed chunk ranges
+#define PACK_RANGE_MAX 16777216     // Bytes, largest coalesced range
+#define AUTO_SAMPLE_CHUNKS 4        // Chunks sampled per instance to
+                                    // choose the codecs of compression
+                                    // auto
+#define AUTO_GAIN_MIN 1.25          // Size ratio a slower codec has to
+                                    // gain over a faster one
 
 #define _STR(x) #x
 #define STR(x) _STR(x)
@@ -73,6 +95,10 @@ namespace scidb {
 
 namespace scidb {
 
+// Key-value metadata of an array, stored in its "metadata" object.
+// Optional keys are only written if they differ from their default,
+// so arrays which do not use a feature stay readable by existing
+// readers.
 class Metadata {
 public:
     enum Format {
@@ -80,8 +106,38 @@ public:
     };
 
     enum Compression {
-        NONE  = 0,
-        GZIP  = 1
+        NONE   = 0,
+        GZIP   = 1,
+        ZSTD   = 2,
+        LZ4    = 3,
+        SNAPPY = 4,
+        AUTO   = 5      // Chosen per column, see getColumnCompression
+    };
+
+    // Codec and level of one column of the chunk objects
+    struct ColumnCompression {
+        Metadata::Compression compression;
+        int level;
+    };
+
+    // How chunk objects are compressed: the whole Arrow stream, or
+    // each column buffer on its own (see ArrowReader)
+    enum CompressionLayout {
+        LAYOUT_STREAM = 0,
+        LAYOUT_COLUMN = 1
+    };
+
+    // Transform applied to the fixed-width value buffers of the
+    // column layout before compression (see ArrowReader)
+    enum CompressionFilter {
+        FILTER_NONE       = 0,
+        FILTER_SHUFFLE    = 1,
+        FILTER_BITSHUFFLE = 2
+    };
+
+    enum IndexFormat {
+        INDEX_ARROW = 0,
+        INDEX_FENCE = 1
     };
 
     Metadata():
@@ -109,22 +165,120 @@ public:
 
     void setCompression(Metadata::Compression compression);
 
+    // Level the chunk objects are compressed with,
+    // COMPRESSION_LEVEL_DEFAULT if the codec default is used. Only
+    // needed by writers.
+    int getCompressionLevel() const;
+
+    void setCompressionLevel(int compressionLevel);
+
+    Metadata::CompressionLayout getCompressionLayout() const;
+
+    void setCompressionLayout(Metadata::CompressionLayout compressionLayout);
+
+    Metadata::CompressionFilter getCompressionFilter() const;
+
+    void setCompressionFilter(Metadata::CompressionFilter compressionFilter);
+
+    // Codec of each column of the chunk objects, attributes followed
+    // by dimensions, for arrays saved with compression AUTO. Empty if
+    // not recorded.
+    std::vector<ColumnCompression> getColumnCompression() const;
+
+    void setColumnCompression(const std::vector<ColumnCompression>&);
+
+    Metadata::IndexFormat getIndexFormat() const;
+
+    void setIndexFormat(Metadata::IndexFormat indexFormat);
+
+    // Number of instances the index is partitioned for, 0 if the
+    // index is not partitioned
+    size_t getIndexPartition() const;
+
+    // Index object numbers where each partition starts; partition i
+    // is stored in index objects [split[i], split[i + 1])
+    std::vector<size_t> getIndexPartitionSplit() const;
+
+    void setIndexPartition(size_t nPart, const std::vector<size_t> &split);
+
+    // Number of hashed sub-directories chunk objects are spread
+    // over, 0 if chunk objects are stored directly in "chunks/"
+    size_t getChunkFanout() const;
+
+    void setChunkFanout(size_t chunkFanout);
+
+    // Target size in bytes of the objects chunks are packed in, 0 if
+    // each chunk is stored in its own object
+    size_t getPackSize() const;
+
+    void setPackSize(size_t packSize);
+
     const ArrayDesc& getSchema(std::shared_ptr<Query> query);
 
     void setSchema(const ArrayDesc &schema);
 
     void validate() const;
 
+    // Serialize & De-serialize as key\tvalue lines, the format of the
+    // metadata object
+    std::string serialize() const;
+    void deserialize(const std::string&);
+
     static std::string coord2ObjectName(const Coordinates &pos,
                                         const Dimensions &dims);
 
+    // Object name of the chunk, relative to the array, e.g.,
+    // "chunks/c_0_1" or, with fan-out, "chunks/3f/c_0_1"
+    static std::string chunkObjectName(const Coordinates &pos,
+                                       const Dimensions &dims,
+                                       size_t chunkFanout);
+
+    // Object name of a pack of chunks, e.g., "packs/p_12" or, with
+    // fan-out, "packs/0a/p_12"
+    static std::string packObjectName(int64_t packID, size_t chunkFanout);
+
 private:
     std::map<std::string, std::string> _metadata;
     bool _hasSchema;
     ArrayDesc _schema;
+
+    // Value of an optional size key, 0 if the key is missing. Throws
+    // if the value is not an integer in [min, max].
+    size_t _getSizeKey(const std::string &key, size_t min, size_t max) const;
+};
+
+// Process-wide pool of threads running blocking driver requests for
+// the asynchronous driver API. The number of threads is set by the
+// driver_threads key in the bridge configuration file (see Config).
+class DriverPool {
+public:
+    static DriverPool& getInstance();
+
+    ~DriverPool();
+
+    template <typename Result>
+    std::future<Result> submit(std::function<Result()> task) {
+        auto packagedTask = std::make_shared<std::packaged_task<Result()> >(
+            std::move(task));
+        auto future = packagedTask->get_future();
+        _enqueue([packagedTask]() { (*packagedTask)(); });
+        return future;
+    }
+
+private:
+    std::mutex _lock;
+    std::condition_variable _cond;
+    std::deque<std::function<void()> > _tasks;
+    std::vector<std::thread> _threads;
+    bool _stop;
+
+    DriverPool(size_t nThreads);
+
+    void _enqueue(std::function<void()>);
+    void _run();
 };
 
-class Driver {
+class Driver: public std::enable_shared_from_this<Driver> {
 public:
     enum Mode {
         READ   = 0,
@@ -155,18 +309,62 @@ public:
     virtual void writeArrow(const std::string&,
                             std::shared_ptr<const arrow::Buffer>) const = 0;
 
+    // Asynchronous requests, run on the DriverPool. The driver is kept
+    // alive until the requests complete.
+    virtual std::future<std::shared_ptr<arrow::Buffer> > readArrowAsync(
+        const std::string&) const;
+
+    virtual std::future<void> writeArrowAsync(
+        const std::string&, std::shared_ptr<const arrow::Buffer>) const;
+
+    // Batch requests, sent concurrently. Wait for all the requests to
+    // complete and re-throw the first failure, if any.
+    std::vector<std::shared_ptr<arrow::Buffer> > readMany(
+        const std::vector<std::string>&) const;
+
+    void writeMany(
+        const std::vector<std::pair<std::string,
+                                    std::shared_ptr<const arrow::Buffer> > >&) const;
+
+    // Read objects in order, with up to maxPending requests
+    // outstanding, and process each buffer once read
+    void readEach(
+        const std::vector<std::string>&,
+        size_t maxPending,
+        const std::function<void(size_t,
+                                 std::shared_ptr<arrow::Buffer>)> &process) const;
+
+    // Read up to length bytes starting at offset. Returns the number
+    // of bytes read.
+    virtual size_t readRange(const std::string &suffix,
+                             size_t offset,
+                             size_t length,
+                             std::shared_ptr<arrow::Buffer> &buffer) const = 0;
+
     inline void readMetadata(std::shared_ptr<Metadata> metadata) const {
         _readMetadataFile(metadata);
         metadata->validate();
     }
     virtual void writeMetadata(std::shared_ptr<const Metadata>) const = 0;
 
+    // Make the objects written so far durable, as configured. Called
+    // once the writes of a query are done.
+    virtual void flush() const {}
+
     // Count number of objects with specified prefix
     virtual size_t count(const std::string&) const = 0;
 
+    // Return a tag which changes when the metadata or any index
+    // object changes. Used to validate cached metadata and indexes.
+    virtual std::string getETag() const = 0;
+
     // Return print-friendly path used by driver
     virtual const std::string& getURL() const = 0;
 
+    // Return true if objects read into new buffers are not copied
+    // (e.g., memory-mapped), so callers should not reuse buffers
+    virtual bool isZeroCopy() const { return false; }
+
     static std::shared_ptr<Driver> makeDriver(const std::string url,
                                               const Mode mode=Mode::READ);
 
@@ -176,10 +374,12 @@ protected:
 
     virtual void _readMetadataFile(std::shared_ptr<Metadata>) const = 0;
 
-    inline void _setBuffer(const std::string &suffix,
-                           std::shared_ptr<arrow::Buffer> &buffer,
-                           bool reuse,
-                           size_t length) const {
+    // Return a fixed-size digest of the stamps of the metadata and
+    // index objects, used as the ETag. The stamps of large indexes are
+    // too long to ship with the plan and to compare on each lookup.
+    static std::string _digestETag(const std::string &stamps);
+
+    inline void _checkSize(const std::string &suffix, size_t length) const {
         if (length > CHUNK_MAX_SIZE) {
             std::ostringstream out;
             out << "Object " << getURL() << "/" << suffix
@@ -188,6 +388,13 @@ protected:
             throw SYSTEM_EXCEPTION(SCIDB_SE_ARRAY_WRITER,
                                    SCIDB_LE_ILLEGAL_OPERATION) << out.str();
         }
+    }
+
+    inline void _setBuffer(const std::string &suffix,
+                           std::shared_ptr<arrow::Buffer> &buffer,
+                           bool reuse,
+                           size_t length) const {
+        _checkSize(suffix, length);
         if (reuse) {
             THROW_NOT_OK(std::static_pointer_cast<arrow::ResizableBuffer>(
                              buffer)->Resize(length, false));
@@ -206,6 +413,25 @@ private:
 
 inline Driver::~Driver() {}
 
+
+// Asynchronous writes with a bounded number of outstanding requests
+class DriverWriteQueue {
+public:
+    DriverWriteQueue(std::shared_ptr<const Driver>,
+                     size_t maxPending=DRIVER_PENDING_DEFAULT);
+
+    // Wait for the oldest write if maxPending writes are outstanding
+    void write(const std::string&, std::shared_ptr<const arrow::Buffer>);
+
+    // Wait for all the writes and re-throw the first failure, if any
+    void wait();
+
+private:
+    std::shared_ptr<const Driver> _driver;
+    const size_t _maxPending;
+    std::deque<std::future<void> > _pending;
+};
+
 } // namespace scidb
 
 #endif  // Driver
@@ -24,14 +24,24 @@
 */
 
 #include "FSDriver.h"
+#include "Config.h"
 
+#include <algorithm>
 #include <boost/filesystem.hpp>
+#include <cerrno>
+#include <fcntl.h>
 #include <fstream>
 #include <log4cxx/logger.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
 
 #include <util/PathUtils.h>
 
 
+#define MMAP_MIN_SIZE 65536     // Bytes, smaller files are copied
+#define DIRECT_IO_ALIGN 4096    // Bytes, O_DIRECT buffer and length alignment
+
 #define FAIL(op, path)                                                          \
     {                                                                           \
         std::ostringstream out;                                                 \
@@ -45,13 +55,50 @@ namespace scidb {
 
     static log4cxx::LoggerPtr logger(log4cxx::Logger::getLogger("scidb.fsdriver"));
 
+    //
+    // FSMappedBuffer
+    //
+    // Buffer over a read-only memory-mapped file, unmapped when the
+    // buffer is destroyed
+    class FSMappedBuffer: public arrow::Buffer {
+    public:
+        FSMappedBuffer(void *data, int64_t size):
+            arrow::Buffer(static_cast<const uint8_t*>(data), size)
+        {}
+
+        ~FSMappedBuffer()
+        {
+            ::munmap(const_cast<uint8_t*>(data_), size_);
+        }
+    };
+
     //
     // FSDriver
     //
     FSDriver::FSDriver(const std::string &url,
                        const Driver::Mode mode):
-        Driver(url, mode)
+        Driver(url, mode),
+        _mmap(false),
+        _directIO(false),
+        _fsync(FSync::NONE)
     {
+        auto config = Config::read();
+        _mmap = config->getBool("fs_mmap", false);
+        _directIO = config->getBool("fs_direct_io", false);
+
+        auto fsync = config->getString("fs_fsync", "none");
+        if (fsync == "query")
+            _fsync = FSync::QUERY;
+        else if (fsync == "file")
+            _fsync = FSync::FILE;
+        else if (fsync != "none")
+            throw USER_EXCEPTION(SCIDB_SE_METADATA, SCIDB_LE_ILLEGAL_OPERATION)
+                << "fs_fsync must be 'none', 'query', or 'file'";
+
+        // Mapped objects are not read using io_uring
+        if (!_mmap && config->getBool("fs_io_uring", false))
+            _engine = FSIOEngine::getInstance();
+
         // Check the URL is valid
         const size_t prefix_len = 7; // "file://"
         if (_url.rfind("file://", 0) != 0) {
@@ -85,8 +132,9 @@ namespace scidb {
             if (boost::filesystem::exists(_prefix))
                 FAIL("Path exists. Path", _prefix);
 
-            // Create base, index, and chunks directories
-            for (const std::string &postfix : {"", "/index", "/chunks"})
+            // Create base, index, and chunks directories. Their
+            // entries are durable with the files published in them.
+            for (const std::string &postfix : {"", "/index", "/chunks"}) {
                 try {
                     // Not an error if the directory exists
                     boost::filesystem::create_directory(_prefix + postfix);
@@ -94,6 +142,8 @@ namespace scidb {
                 catch (const std::exception &ex) {
                     FAIL("Create directory", _prefix + postfix);
                 }
+                _syncParent(_prefix + postfix);
+            }
         }
     }
 
@@ -102,6 +152,38 @@ namespace scidb {
                                 bool reuse) const
     {
         auto path = _prefix + "/" + suffix;
+
+        // Map the file into a new buffer, Arrow reads straight from
+        // the page cache
+        if (_mmap && !reuse) {
+            int fd = ::open(path.c_str(), O_RDONLY);
+            if (fd < 0) FAIL("Open", path);
+
+            struct stat st;
+            if (::fstat(fd, &st) != 0) {
+                ::close(fd);
+                FAIL("Stat", path);
+            }
+            size_t length = st.st_size;
+
+            if (length >= MMAP_MIN_SIZE) {
+                void *data = MAP_FAILED;
+                if (length <= CHUNK_MAX_SIZE)
+                    data = ::mmap(NULL, length, PROT_READ, MAP_PRIVATE, fd, 0);
+                ::close(fd);
+                _checkSize(suffix, length);
+                if (data == MAP_FAILED) FAIL("Map", path);
+
+                // Objects are decoded front to back
+                ::madvise(data, length, MADV_SEQUENTIAL);
+                ::madvise(data, length, MADV_WILLNEED);
+
+                buffer = std::make_shared<FSMappedBuffer>(data, length);
+                return length;
+            }
+            ::close(fd);
+        }
+
         std::ifstream stream(path, std::ifstream::binary);
         if (stream.fail()) FAIL("Open", path);
 
@@ -127,38 +209,294 @@ namespace scidb {
         return length;
     }
 
+    std::string FSDriver::_writePath(const std::string &suffix) const
+    {
+        // Create the directory of the object (e.g., "index" or a
+        // chunk sub-directory), if needed. Directories found are
+        // remembered, to avoid checking for each object.
+        auto slash = suffix.rfind('/');
+        if (slash != std::string::npos) {
+            auto directory = _prefix + "/" + suffix.substr(0, slash);
+            std::lock_guard<std::mutex> lock(_dirLock);
+            if (_dirs.find(directory) == _dirs.end()) {
+                if (!boost::filesystem::exists(directory)) {
+                    try {
+                        // Not an error if another instance created it
+                        boost::filesystem::create_directory(directory);
+                    }
+                    catch (const std::exception &ex) {
+                        FAIL("Create directory", directory);
+                    }
+                    _syncParent(directory);
+                }
+                _dirs.insert(directory);
+            }
+        }
+
+        return _prefix + "/" + suffix;
+    }
+
+    std::string FSDriver::_tempPath(const std::string &path)
+    {
+        // Hidden, so it is not counted as an object
+        auto slash = path.rfind('/');
+        return path.substr(0, slash + 1) + "." + path.substr(slash + 1) + ".tmp";
+    }
+
+    int FSDriver::_openTemp(const std::string &path, size_t length) const
+    {
+        auto temp = _tempPath(path);
+        int fd = ::open(temp.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0666);
+        if (fd < 0) FAIL("Open", temp);
+
+        // Reserve contiguous space up-front. Not supported by all
+        // file systems (e.g., NFSv3), in which case the write
+        // allocates as usual.
+        if (length > 0 && ::fallocate(fd, 0, 0, length) != 0)
+            LOG4CXX_DEBUG(logger, "FSDRIVER|fallocate errno:" << errno
+                          << " path:" << temp);
+        return fd;
+    }
+
+    void FSDriver::_publish(const std::string &path) const
+    {
+        auto temp = _tempPath(path);
+        if (::rename(temp.c_str(), path.c_str()) != 0) {
+            ::unlink(temp.c_str());
+            FAIL("Rename", temp);
+        }
+
+        // The rename is durable once the directory is synced
+        if (_fsync == FSync::QUERY) {
+            std::lock_guard<std::mutex> lock(_syncLock);
+            _syncPaths.insert(path);
+        }
+        _syncParent(path);
+    }
+
+    void FSDriver::_syncParent(const std::string &path) const
+    {
+        auto directory = path.substr(0, path.rfind('/'));
+        if (_fsync == FSync::FILE) {
+            int fd = ::open(directory.c_str(), O_RDONLY | O_DIRECTORY);
+            if (fd < 0) FAIL("Open", directory);
+            int synced = ::fsync(fd);
+            ::close(fd);
+            if (synced != 0) FAIL("Sync", directory);
+        }
+        else if (_fsync == FSync::QUERY) {
+            std::lock_guard<std::mutex> lock(_syncLock);
+            _syncPaths.insert(directory);
+        }
+    }
+
+    void FSDriver::_writeFile(const std::string &path,
+                              const void *data,
+                              size_t length) const
+    {
+        auto temp = _tempPath(path);
+        int fd = _openTemp(path, length);
+
+        // Write the whole buffer with as few calls as possible
+        const char *pos = static_cast<const char*>(data);
+        size_t left = length;
+        while (left > 0) {
+            ssize_t n = ::write(fd, pos, left);
+            if (n < 0 && errno == EINTR)
+                continue;
+            if (n <= 0) {
+                ::close(fd);
+                ::unlink(temp.c_str());
+                FAIL("Write", temp);
+            }
+            pos += n;
+            left -= n;
+        }
+
+        if (_fsync == FSync::FILE && ::fsync(fd) != 0) {
+            ::close(fd);
+            ::unlink(temp.c_str());
+            FAIL("Sync", temp);
+        }
+        if (::close(fd) != 0) {
+            ::unlink(temp.c_str());
+            FAIL("Close", temp);
+        }
+
+        _publish(path);
+    }
+
     void FSDriver::writeArrow(const std::string &suffix,
                               std::shared_ptr<const arrow::Buffer> buffer) const
     {
-        std::string path;
+        _writeFile(_writePath(suffix), buffer->data(), buffer->size());
+    }
 
-        // Check if writing index file
-        if (suffix.rfind("index/", 0) == 0) {
-            path = _prefix + "/index";
+    void FSDriver::flush() const
+    {
+        std::set<std::string> paths;
+        {
+            std::lock_guard<std::mutex> lock(_syncLock);
+            paths.swap(_syncPaths);
+        }
+        if (paths.empty())
+            return;
+
+        // Files sort before their directory is synced, since the
+        // directory path is a prefix of the file path
+        for (auto i = paths.rbegin(); i != paths.rend(); ++i) {
+            int fd = ::open(i->c_str(), O_RDONLY);
+            if (fd < 0) FAIL("Open", *i);
+            int synced = ::fsync(fd);
+            ::close(fd);
+            if (synced != 0) FAIL("Sync", *i);
+        }
 
-            // Check if index directory exists
-            if (!boost::filesystem::exists(path)) {
+        LOG4CXX_DEBUG(logger, "FSDRIVER|flush paths:" << paths.size());
+    }
 
-                // Create index directory
-                try {
-                    boost::filesystem::create_directory(path);
-                }
-                catch (const std::exception &ex) {
-                    FAIL("Create directory", path);
-                }
+    std::future<std::shared_ptr<arrow::Buffer> > FSDriver::readArrowAsync(
+        const std::string &suffix) const
+    {
+        if (!_engine)
+            return Driver::readArrowAsync(suffix);
+
+        auto promise = std::make_shared<std::promise<std::shared_ptr<arrow::Buffer> > >();
+        auto future = promise->get_future();
+        auto path = _prefix + "/" + suffix;
+        int fd = -1;
+        try {
+            // O_DIRECT is not supported by all file systems (e.g.,
+            // tmpfs), use the page cache instead
+            bool direct = false;
+            if (_directIO) {
+                fd = ::open(path.c_str(), O_RDONLY | O_DIRECT);
+                direct = fd >= 0;
             }
+            if (fd < 0)
+                fd = ::open(path.c_str(), O_RDONLY);
+            if (fd < 0) FAIL("Open", path);
+
+            struct stat st;
+            if (::fstat(fd, &st) != 0) FAIL("Stat", path);
+            size_t length = st.st_size;
+            _checkSize(suffix, length);
+
+            // O_DIRECT requires aligned memory and lengths. Read into
+            // an aligned slice of a larger buffer.
+            size_t capacity = length, offset = 0;
+            if (direct)
+                capacity = (length + DIRECT_IO_ALIGN - 1)
+                    / DIRECT_IO_ALIGN * DIRECT_IO_ALIGN;
+            std::shared_ptr<arrow::Buffer> buffer;
+            THROW_NOT_OK(arrow::AllocateBuffer(
+                             capacity + (direct ? DIRECT_IO_ALIGN : 0),
+                             &buffer));
+            if (direct) {
+                auto address = reinterpret_cast<uintptr_t>(buffer->data());
+                offset = (DIRECT_IO_ALIGN - address % DIRECT_IO_ALIGN)
+                    % DIRECT_IO_ALIGN;
+            }
+            auto data = buffer->mutable_data() + offset;
+            if (direct)
+                buffer = arrow::SliceBuffer(buffer, offset, length);
+
+            _engine->read(
+                fd, data, length, capacity, 0,
+                [promise, buffer, path, fd, length](ssize_t result) {
+                    ::close(fd);
+                    try {
+                        if (result < 0 || static_cast<size_t>(result) != length)
+                            FAIL("Read", path);
+                        promise->set_value(buffer);
+                    }
+                    catch (...) {
+                        promise->set_exception(std::current_exception());
+                    }
+                },
+                direct ? DIRECT_IO_ALIGN : 1);
+        }
+        catch (...) {
+            if (fd >= 0)
+                ::close(fd);
+            promise->set_exception(std::current_exception());
         }
+        return future;
+    }
 
-        path = _prefix + "/" + suffix;
-        std::ofstream stream(path, std::ofstream::binary);
+    std::future<void> FSDriver::writeArrowAsync(
+        const std::string &suffix,
+        std::shared_ptr<const arrow::Buffer> buffer) const
+    {
+        // Syncing each file would block the completion thread
+        if (!_engine || _fsync == FSync::FILE)
+            return Driver::writeArrowAsync(suffix, buffer);
+
+        auto promise = std::make_shared<std::promise<void> >();
+        auto future = promise->get_future();
+        try {
+            auto path = _writePath(suffix);
+            int fd = _openTemp(path, buffer->size());
+
+            // The driver and the buffer are kept alive until the write
+            // completes
+            auto driver = std::static_pointer_cast<const FSDriver>(
+                shared_from_this());
+            _engine->write(
+                fd, buffer->data(), buffer->size(), 0,
+                [driver, promise, buffer, path, fd](ssize_t result) {
+                    int closed = ::close(fd);
+                    try {
+                        auto temp = _tempPath(path);
+                        if (result < 0 || result != buffer->size()) {
+                            ::unlink(temp.c_str());
+                            FAIL("Write", temp);
+                        }
+                        if (closed != 0) {
+                            ::unlink(temp.c_str());
+                            FAIL("Close", temp);
+                        }
+                        driver->_publish(path);
+                        promise->set_value();
+                    }
+                    catch (...) {
+                        promise->set_exception(std::current_exception());
+                    }
+                });
+        }
+        catch (...) {
+            promise->set_exception(std::current_exception());
+        }
+        return future;
+    }
+
+    size_t FSDriver::readRange(const std::string &suffix,
+                               size_t offset,
+                               size_t length,
+                               std::shared_ptr<arrow::Buffer> &buffer) const
+    {
+        auto path = _prefix + "/" + suffix;
+        std::ifstream stream(path, std::ifstream::binary);
         if (stream.fail()) FAIL("Open", path);
 
-        stream.write(reinterpret_cast<const char*>(buffer->data()),
-                     buffer->size());
+        stream.seekg(0, std::ios_base::end);
+        if (stream.fail()) FAIL("Set position", path);
+
+        size_t size = stream.tellg();
+        if (stream.fail()) FAIL("Get position", path);
+
+        // Range might extend past the end of the file
+        length = offset < size ? std::min(length, size - offset) : 0;
+        _setBuffer(suffix, buffer, false, length);
+
+        stream.seekg(offset);
+        if (stream.fail()) FAIL("Set position", path);
+
+        stream.read(reinterpret_cast<char*>(buffer->mutable_data()),
+                    length);
         if (!stream) FAIL("Read", path);
 
-        stream.close();
-        if (stream.fail()) FAIL("Close", path);
+        return length;
     }
 
     void FSDriver::_readMetadataFile(std::shared_ptr<Metadata> metadata) const
@@ -185,14 +523,8 @@ namespace scidb {
 
     void FSDriver::writeMetadata(std::shared_ptr<const Metadata> metadata) const
     {
-        auto path = _prefix + "/metadata";
-        std::ofstream stream(path);
-        if (stream.fail()) FAIL("Open", path);
-
-        for (auto i = metadata->begin(); i != metadata->end(); ++i) {
-            stream << i->first << "\t" << i->second << "\n";
-            if (stream.fail()) FAIL("Write", path);
-        }
+        auto data = metadata->serialize();
+        _writeFile(_prefix + "/metadata", data.data(), data.size());
     }
 
     size_t FSDriver::count(const std::string& suffix) const
@@ -203,7 +535,9 @@ namespace scidb {
             for (auto i = boost::filesystem::directory_iterator(path);
                  i != boost::filesystem::directory_iterator();
                  ++i)
-                if (!is_directory(i->path()))
+                // Skip temporary files
+                if (!is_directory(i->path())
+                    && i->path().filename().native().rfind(".", 0) != 0)
                     count++;
         }
         catch (const std::exception &ex) {
@@ -212,6 +546,46 @@ namespace scidb {
         return count;
     }
 
+    std::string FSDriver::getETag() const
+    {
+        std::ostringstream out;
+
+        // Modification time (in nanoseconds) and size of the metadata
+        // and of each index file
+        auto stamp = [&out](const std::string &path) {
+            struct stat st;
+            if (::stat(path.c_str(), &st) != 0) FAIL("Stat", path);
+            out << path << ":" << st.st_mtim.tv_sec << "."
+                << st.st_mtim.tv_nsec << ":" << st.st_size << ";";
+        };
+
+        stamp(_prefix + "/metadata");
+
+        std::vector<std::string> paths;
+        boost::filesystem::path path(_prefix + "/index");
+        try {
+            for (auto i = boost::filesystem::directory_iterator(path);
+                 i != boost::filesystem::directory_iterator();
+                 ++i)
+                // Skip temporary files
+                if (i->path().filename().native().rfind(".", 0) != 0)
+                    paths.push_back(i->path().native());
+        }
+        catch (const std::exception &ex) {
+            FAIL("List directory", path.native());
+        }
+        std::sort(paths.begin(), paths.end());
+        for (auto const &path : paths)
+            stamp(path);
+
+        return _digestETag(out.str());
+    }
+
+    bool FSDriver::isZeroCopy() const
+    {
+        return _mmap;
+    }
+
     const std::string& FSDriver::getURL() const
     {
         return _url;
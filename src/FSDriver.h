@@ -27,12 +27,23 @@
 #define FS_DRIVER_H_
 
 #include "Driver.h"
+#include "FSIOEngine.h"
+
+#include <mutex>
+#include <set>
 
 
 namespace scidb {
 
 class FSDriver: public Driver {
 public:
+    // When written files are synced to storage
+    enum class FSync {
+        NONE  = 0,              // Left to the OS
+        QUERY = 1,              // Once, when the driver is flushed
+        FILE  = 2               // Each file, before it is published
+    };
+
     FSDriver(const std::string &url, const Driver::Mode);
 
     void init(const Query&);
@@ -40,11 +51,32 @@ public:
     void writeArrow(const std::string&,
                     std::shared_ptr<const arrow::Buffer>) const;
 
+    // Asynchronous requests use io_uring, if available, instead of
+    // the DriverPool
+    std::future<std::shared_ptr<arrow::Buffer> > readArrowAsync(
+        const std::string&) const;
+
+    std::future<void> writeArrowAsync(
+        const std::string&, std::shared_ptr<const arrow::Buffer>) const;
+
+    size_t readRange(const std::string&,
+                     size_t offset,
+                     size_t length,
+                     std::shared_ptr<arrow::Buffer>&) const;
+
     void writeMetadata(std::shared_ptr<const Metadata>) const;
 
+    // Sync files published since the last flush, if fs_fsync = query
+    void flush() const;
+
     // Count number of objects with specified prefix
     size_t count(const std::string&) const;
 
+    std::string getETag() const;
+
+    // Objects are memory-mapped if enabled
+    bool isZeroCopy() const;
+
     // Return print-friendly path used by driver
     const std::string& getURL() const;
 
@@ -54,7 +86,40 @@ protected:
 private:
     std::string _prefix;
 
+    // Map objects read into new buffers instead of copying them
+    bool _mmap;
+
+    // NULL if io_uring is disabled or not available
+    std::shared_ptr<FSIOEngine> _engine;
+
+    // Asynchronous reads bypass the page cache
+    bool _directIO;
+
+    FSync _fsync;
+
+    // Files and directories to sync on flush
+    mutable std::mutex _syncLock;
+    mutable std::set<std::string> _syncPaths;
+
+    // Directories known to exist
+    mutable std::mutex _dirLock;
+    mutable std::set<std::string> _dirs;
+
     size_t _readArrow(const std::string&, std::shared_ptr<arrow::Buffer>&, bool) const;
+
+    // Return the path for writing, create the object directory if
+    // needed
+    std::string _writePath(const std::string&) const;
+
+    // Files are written to a temporary path and then renamed, so
+    // readers never see partial files
+    static std::string _tempPath(const std::string&);
+    int _openTemp(const std::string&, size_t length) const;
+    void _publish(const std::string &path) const;
+
+    // Sync, or record for flush, the directory entry of the path
+    void _syncParent(const std::string &path) const;
+    void _writeFile(const std::string &path, const void *data, size_t length) const;
 };
 
 } // namespace scidb
@@ -0,0 +1,324 @@
+/*
+**
+* BEGIN_COPYRIGHT
+*
+* Copyright (C) 2020-2021 Paradigm4 Inc.
+* All Rights Reserved.
+*
+* bridge is a plugin for SciDB, an Open Source Array DBMS maintained
+* by Paradigm4. See http://www.paradigm4.com/
+*
+* bridge is free software: you can redistribute it and/or modify
+* it under the terms of the AFFERO GNU General Public License as published by
+* the Free Software Foundation.
+*
+* bridge is distributed "AS-IS" AND WITHOUT ANY WARRANTY OF ANY KIND,
+* INCLUDING ANY IMPLIED WARRANTY OF MERCHANTABILITY,
+* NON-INFRINGEMENT, OR FITNESS FOR A PARTICULAR PURPOSE. See
+* the AFFERO GNU General Public License for the complete license terms.
+*
+* You should have received a copy of the AFFERO GNU General Public License
+* along with bridge.  If not, see <http://www.gnu.org/licenses/agpl-3.0.html>
+*
+* END_COPYRIGHT
+*/
+
+#include "FSIOEngine.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+#include <log4cxx/logger.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+// io_uring is available with Linux 5.1 and later headers
+#if defined(__has_include)
+#if __has_include(<linux/io_uring.h>) && defined(__NR_io_uring_setup)
+#include <linux/io_uring.h>
+#define FS_IO_URING 1
+#endif
+#endif
+
+
+namespace scidb {
+
+static log4cxx::LoggerPtr logger(log4cxx::Logger::getLogger("scidb.fsioengine"));
+
+//
+// FSIOEngine
+//
+FSIOEngine::FSIOEngine():
+    _ringFd(-1),
+    _sqRing(MAP_FAILED),
+    _sqRingSize(0),
+    _sqes(MAP_FAILED),
+    _sqesSize(0),
+    _cqRing(MAP_FAILED),
+    _cqRingSize(0),
+    _entries(0),
+    _inFlight(0)
+{}
+
+std::shared_ptr<FSIOEngine> FSIOEngine::getInstance() {
+    static std::shared_ptr<FSIOEngine> instance = []() {
+        std::shared_ptr<FSIOEngine> engine(new FSIOEngine());
+        if (!engine->_init()) {
+            LOG4CXX_INFO(logger, "FSIOENGINE|io_uring not available");
+            return std::shared_ptr<FSIOEngine>();
+        }
+        engine->_thread = std::thread(&FSIOEngine::_reap, engine.get());
+        return engine;
+    }();
+    return instance;
+}
+
+#ifdef FS_IO_URING
+
+FSIOEngine::~FSIOEngine() {
+    if (_thread.joinable()) {
+        // Stop the completion thread with a request without data, see
+        // _reap
+        {
+            std::unique_lock<std::mutex> lock(_lock);
+            _cond.wait(lock, [this]() { return _inFlight < _entries; });
+
+            unsigned tail = *_sqTail;
+            unsigned index = tail & *_sqMask;
+            auto sqe = &static_cast<struct io_uring_sqe*>(_sqes)[index];
+            std::memset(sqe, 0, sizeof(*sqe));
+            sqe->opcode = IORING_OP_NOP;
+            sqe->user_data = 0;
+            _sqArray[index] = index;
+            __atomic_store_n(_sqTail, tail + 1, __ATOMIC_RELEASE);
+            syscall(__NR_io_uring_enter, _ringFd, 1, 0, 0, NULL, 0);
+        }
+        _thread.join();
+    }
+
+    if (_sqes != MAP_FAILED)
+        ::munmap(_sqes, _sqesSize);
+    if (_cqRing != MAP_FAILED)
+        ::munmap(_cqRing, _cqRingSize);
+    if (_sqRing != MAP_FAILED)
+        ::munmap(_sqRing, _sqRingSize);
+    if (_ringFd >= 0)
+        ::close(_ringFd);
+}
+
+bool FSIOEngine::_init() {
+    struct io_uring_params params;
+    std::memset(&params, 0, sizeof(params));
+
+    // Fails with ENOSYS on kernels without io_uring or EPERM if
+    // disabled
+    _ringFd = syscall(__NR_io_uring_setup, FS_IO_ENTRIES, &params);
+    if (_ringFd < 0) {
+        LOG4CXX_DEBUG(logger, "FSIOENGINE|setup errno:" << errno);
+        return false;
+    }
+    _entries = params.sq_entries;
+
+    // Map Submission Ring, Submission Entries, and Completion Ring
+    _sqRingSize = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    _sqRing = ::mmap(NULL, _sqRingSize, PROT_READ | PROT_WRITE,
+                     MAP_SHARED | MAP_POPULATE, _ringFd, IORING_OFF_SQ_RING);
+    _sqesSize = params.sq_entries * sizeof(struct io_uring_sqe);
+    _sqes = ::mmap(NULL, _sqesSize, PROT_READ | PROT_WRITE,
+                   MAP_SHARED | MAP_POPULATE, _ringFd, IORING_OFF_SQES);
+    _cqRingSize = params.cq_off.cqes
+        + params.cq_entries * sizeof(struct io_uring_cqe);
+    _cqRing = ::mmap(NULL, _cqRingSize, PROT_READ | PROT_WRITE,
+                     MAP_SHARED | MAP_POPULATE, _ringFd, IORING_OFF_CQ_RING);
+    if (_sqRing == MAP_FAILED || _sqes == MAP_FAILED || _cqRing == MAP_FAILED) {
+        LOG4CXX_DEBUG(logger, "FSIOENGINE|mmap errno:" << errno);
+        return false;
+    }
+
+    char *sq = static_cast<char*>(_sqRing);
+    _sqHead = reinterpret_cast<unsigned*>(sq + params.sq_off.head);
+    _sqTail = reinterpret_cast<unsigned*>(sq + params.sq_off.tail);
+    _sqMask = reinterpret_cast<unsigned*>(sq + params.sq_off.ring_mask);
+    _sqArray = reinterpret_cast<unsigned*>(sq + params.sq_off.array);
+
+    char *cq = static_cast<char*>(_cqRing);
+    _cqHead = reinterpret_cast<unsigned*>(cq + params.cq_off.head);
+    _cqTail = reinterpret_cast<unsigned*>(cq + params.cq_off.tail);
+    _cqMask = reinterpret_cast<unsigned*>(cq + params.cq_off.ring_mask);
+    _cqes = cq + params.cq_off.cqes;
+
+    LOG4CXX_DEBUG(logger, "FSIOENGINE|init entries:" << _entries);
+    return true;
+}
+
+int FSIOEngine::_queue(Request *request) {
+    unsigned tail = *_sqTail;
+    unsigned index = tail & *_sqMask;
+    auto sqe = &static_cast<struct io_uring_sqe*>(_sqes)[index];
+    std::memset(sqe, 0, sizeof(*sqe));
+
+    // Resume From an Aligned Position, Re-Reading a Few Bytes if
+    // Needed
+    request->resume = request->done / request->align * request->align;
+
+    // Vectored operations are supported by all io_uring kernels
+    request->iov.iov_base = request->data + request->resume;
+    request->iov.iov_len = request->capacity - request->resume;
+    sqe->opcode = request->write ? IORING_OP_WRITEV : IORING_OP_READV;
+    sqe->fd = request->fd;
+    sqe->addr = reinterpret_cast<uint64_t>(&request->iov);
+    sqe->len = 1;
+    sqe->off = request->offset + request->resume;
+    sqe->user_data = reinterpret_cast<uint64_t>(request);
+
+    _sqArray[index] = index;
+    __atomic_store_n(_sqTail, tail + 1, __ATOMIC_RELEASE);
+    _inFlight++;
+
+    int ret;
+    while ((ret = syscall(__NR_io_uring_enter, _ringFd, 1, 0, 0, NULL, 0)) < 0
+           && (errno == EINTR || errno == EAGAIN))
+        ;
+    if (ret < 0) {
+        // Nothing Was Submitted, Take the Entry Back
+        int err = errno;
+        __atomic_store_n(_sqTail, tail, __ATOMIC_RELEASE);
+        _inFlight--;
+        LOG4CXX_WARN(logger, "FSIOENGINE|submit errno:" << err);
+        return -err;
+    }
+    return 0;
+}
+
+void FSIOEngine::_reap() {
+    unsigned failures = 0;
+    while (true) {
+        // Only this thread moves the completion head
+        unsigned head = *_cqHead;
+        if (head == __atomic_load_n(_cqTail, __ATOMIC_ACQUIRE)) {
+            if (syscall(__NR_io_uring_enter, _ringFd, 0, 1,
+                        IORING_ENTER_GETEVENTS, NULL, 0) < 0
+                && errno != EINTR) {
+                // Persistent Errors (e.g., ENOMEM) Are Logged Once and
+                // Retried With Exponential Back-Off
+                if (failures == 0)
+                    LOG4CXX_WARN(logger, "FSIOENGINE|enter errno:" << errno);
+                std::this_thread::sleep_for(std::chrono::milliseconds(
+                    std::min(1u << std::min(failures, 10u),
+                             static_cast<unsigned>(FS_IO_BACKOFF_MAX))));
+                failures++;
+            }
+            else
+                failures = 0;
+            continue;
+        }
+
+        auto cqe = &static_cast<struct io_uring_cqe*>(_cqes)[head & *_cqMask];
+        Request *request = reinterpret_cast<Request*>(cqe->user_data);
+        int result = cqe->res;
+        __atomic_store_n(_cqHead, head + 1, __ATOMIC_RELEASE);
+
+        // Stop request
+        if (request == NULL)
+            return;
+
+        {
+            std::lock_guard<std::mutex> lock(_lock);
+            _inFlight--;
+
+            // Resubmit interrupted requests and the rest of short
+            // transfers which made progress
+            size_t done = request->done;
+            if (result > 0)
+                request->done = std::max(done, request->resume + result);
+            if (result == -EINTR || result == -EAGAIN
+                || (result > 0
+                    && request->done > done
+                    && request->done < request->length)) {
+                int err = _queue(request);
+                if (err == 0)
+                    continue;
+                result = err;
+            }
+        }
+        _cond.notify_all();
+
+        _complete(request, result < 0 ? result : request->done);
+    }
+}
+
+#else  // FS_IO_URING
+
+FSIOEngine::~FSIOEngine() {}
+
+bool FSIOEngine::_init() {
+    return false;
+}
+
+int FSIOEngine::_queue(Request*) {
+    return -ENOSYS;
+}
+
+void FSIOEngine::_reap() {}
+
+#endif  // FS_IO_URING
+
+void FSIOEngine::_submit(Request *request) {
+    int err;
+    {
+        std::unique_lock<std::mutex> lock(_lock);
+        _cond.wait(lock, [this]() { return _inFlight < _entries; });
+        err = _queue(request);
+    }
+    if (err != 0) {
+        _cond.notify_all();
+        _complete(request, err);
+    }
+}
+
+void FSIOEngine::_complete(Request *request, ssize_t result) {
+    request->callback(result);
+    delete request;
+}
+
+void FSIOEngine::read(int fd,
+                      void *data,
+                      size_t length,
+                      size_t capacity,
+                      off_t offset,
+                      Callback callback,
+                      size_t align) {
+    Request *request = new Request();
+    request->fd = fd;
+    request->write = false;
+    request->data = static_cast<char*>(data);
+    request->length = length;
+    request->capacity = std::max(length, capacity);
+    request->offset = offset;
+    request->align = std::max<size_t>(align, 1);
+    request->done = 0;
+    request->callback = callback;
+    _submit(request);
+}
+
+void FSIOEngine::write(int fd,
+                       const void *data,
+                       size_t length,
+                       off_t offset,
+                       Callback callback) {
+    Request *request = new Request();
+    request->fd = fd;
+    request->write = true;
+    request->data = const_cast<char*>(static_cast<const char*>(data));
+    request->length = length;
+    request->capacity = length;
+    request->offset = offset;
+    request->align = 1;
+    request->done = 0;
+    request->callback = callback;
+    _submit(request);
+}
+
+} // namespace scidb
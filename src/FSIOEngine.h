@@ -0,0 +1,147 @@
+/*
+**
+* BEGIN_COPYRIGHT
+*
+* Copyright (C) 2020-2021 Paradigm4 Inc.
+* All Rights Reserved.
+*
+* bridge is a plugin for SciDB, an Open Source Array DBMS maintained
+* by Paradigm4. See http://www.paradigm4.com/
+*
+* bridge is free software: you can redistribute it and/or modify
+* it under the terms of the AFFERO GNU General Public License as published by
+* the Free Software Foundation.
+*
+* bridge is distributed "AS-IS" AND WITHOUT ANY WARRANTY OF ANY KIND,
+* INCLUDING ANY IMPLIED WARRANTY OF MERCHANTABILITY,
+* NON-INFRINGEMENT, OR FITNESS FOR A PARTICULAR PURPOSE. See
+* the AFFERO GNU General Public License for the complete license terms.
+*
+* You should have received a copy of the AFFERO GNU General Public License
+* along with bridge.  If not, see <http://www.gnu.org/licenses/agpl-3.0.html>
+*
+* END_COPYRIGHT
+*/
+
+#ifndef FS_IO_ENGINE_H_
+#define FS_IO_ENGINE_H_
+
+#include <condition_variable>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+#include <sys/types.h>
+#include <sys/uio.h>
+
+
+#define FS_IO_ENTRIES 256       // Submission queue size
+#define FS_IO_BACKOFF_MAX 100   // Milliseconds, longest wait after a
+                                // failed completion wait
+
+
+namespace scidb {
+
+// --
+// -- - FSIOEngine - --
+// --
+
+// Asynchronous file reads and writes using io_uring, so many requests
+// can be outstanding at the storage. The ring is set up using the raw
+// system calls, no library is required. Requests are submitted by the
+// calling threads and completed on one completion thread, which calls
+// the request callback. Callbacks should be short. Short reads and
+// writes are resubmitted for the remaining bytes.
+class FSIOEngine {
+public:
+    typedef std::function<void(ssize_t result)> Callback;
+
+    // Return the process-wide engine, NULL if io_uring is not
+    // supported by the kernel or the build
+    static std::shared_ptr<FSIOEngine> getInstance();
+
+    ~FSIOEngine();
+
+    // Read or write length bytes at offset. The callback gets the
+    // number of bytes transferred, smaller than length at the end of
+    // the file, or a negative errno. Blocks while the ring is full.
+    // Reads can fill data up to capacity, e.g., when the buffer is
+    // rounded up for O_DIRECT. The rest of short reads is read from
+    // a multiple of align bytes, e.g., DIRECT_IO_ALIGN for O_DIRECT.
+    void read(int fd,
+              void *data,
+              size_t length,
+              size_t capacity,
+              off_t offset,
+              Callback,
+              size_t align=1);
+    void write(int fd,
+               const void *data,
+               size_t length,
+               off_t offset,
+               Callback);
+
+private:
+    struct Request {
+        int fd;
+        bool write;
+        char *data;
+        size_t length;
+        size_t capacity;
+        off_t offset;
+        size_t align;
+        size_t done;
+        size_t resume;          // Start of the last submission
+        struct iovec iov;
+        Callback callback;
+    };
+
+    int _ringFd;
+
+    // Submission Ring
+    void *_sqRing;
+    size_t _sqRingSize;
+    unsigned *_sqHead;
+    unsigned *_sqTail;
+    unsigned *_sqMask;
+    unsigned *_sqArray;
+    void *_sqes;
+    size_t _sqesSize;
+
+    // Completion Ring
+    void *_cqRing;
+    size_t _cqRingSize;
+    unsigned *_cqHead;
+    unsigned *_cqTail;
+    unsigned *_cqMask;
+    void *_cqes;
+
+    std::mutex _lock;
+    std::condition_variable _cond;
+    unsigned _entries;
+    unsigned _inFlight;
+    std::thread _thread;
+
+    FSIOEngine();
+
+    // Set up the ring, return false if io_uring is not available
+    bool _init();
+
+    // Queue the remaining bytes of the request. Returns 0, or a
+    // negative errno if the request could not be submitted, in which
+    // case it is not queued. Requires lock.
+    int _queue(Request*);
+    void _submit(Request*);
+
+    // Call the request callback and delete the request. Requires no
+    // lock.
+    void _complete(Request*, ssize_t result);
+
+    // Completion thread loop
+    void _reap();
+};
+
+} // namespace scidb
+
+#endif  // FSIOEngine
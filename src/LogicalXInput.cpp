@@ -24,7 +24,9 @@
 */
 
 #include "XInputSettings.h"
+#include "XInputCache.h"
 
+#include <query/LogicalExpression.h>
 #include <rbac/Rights.h>
 
 namespace scidb {
@@ -62,10 +64,8 @@ public:
             _driver = Driver::makeDriver(_settings->getURL());
 
         // Read Metadata
-        if (_metadata == NULL) {
-            _metadata = std::make_shared<Metadata>();
-            _driver->readMetadata(_metadata);
-        }
+        if (_metadata == NULL)
+            _readMetadata(query);
 
         auto namespaceName = (*_metadata)["namespace"];
         LOG4CXX_DEBUG(logger,
@@ -86,16 +86,22 @@ public:
         _driver->init(*query);
 
         // Read Metadata
-        if (_metadata == NULL) {
-            _metadata = std::make_shared<Metadata>();
-            _driver->readMetadata(_metadata);
-        }
+        if (_metadata == NULL)
+            _readMetadata(query);
 
         LOG4CXX_DEBUG(logger,
                       "XINPUT|" << query->getInstanceID()
                       << "|schema: " << (*_metadata)["schema"]);
         ArrayDesc schema = _metadata->getSchema(query);
         schema.setDistribution(createDistribution(defaultDistType()));
+
+        // Ship Metadata and ETag with the Plan, Instances Do Not Need
+        // to Read Them
+        if (_kwParameters.find(KW_METADATA) == _kwParameters.end()) {
+            _kwParameters[KW_METADATA] = _makeParam(_metadata->serialize());
+            _kwParameters[KW_ETAG] = _makeParam(_eTag);
+        }
+
         return schema;
     }
 
@@ -103,6 +109,34 @@ private:
     std::shared_ptr<XInputSettings> _settings;
     std::shared_ptr<Driver> _driver;
     std::shared_ptr<Metadata> _metadata;
+    std::string _eTag;
+
+    // Make a constant string parameter
+    Parameter _makeParam(const std::string &value) const {
+        auto const &context = _parameters[0]->getParsingContext();
+        Value val;
+        val.setString(value);
+        return std::make_shared<OperatorParamLogicalExpression>(
+            context,
+            std::make_shared<Constant>(context, val, TID_STRING),
+            TID_STRING,
+            true);
+    }
+
+    // Get metadata from the instance cache or read it. The schema is
+    // parsed before the metadata is cached.
+    void _readMetadata(const std::shared_ptr<Query> &query) {
+        auto &cache = XInputCache::getInstance();
+        _eTag = _driver->getETag();
+
+        _metadata = cache.getMetadata(_settings->getURL(), _eTag);
+        if (_metadata == NULL) {
+            _metadata = std::make_shared<Metadata>();
+            _driver->readMetadata(_metadata);
+            _metadata->getSchema(query);
+            cache.setMetadata(_settings->getURL(), _eTag, _metadata);
+        }
+    }
 };
 
 REGISTER_LOGICAL_OPERATOR_FACTORY(LogicalXInput, "xinput");
@@ -56,7 +56,14 @@ public:
             { KW_UPDATE,        RE(PP(PLACEHOLDER_CONSTANT, TID_BOOL))   },
             { KW_FORMAT,        RE(PP(PLACEHOLDER_CONSTANT, TID_STRING)) },
             { KW_COMPRESSION,   RE(PP(PLACEHOLDER_CONSTANT, TID_STRING)) },
-            { KW_INDEX_SPLIT,   RE(PP(PLACEHOLDER_CONSTANT, TID_INT64))  }
+            { KW_COMPRESSION_LEVEL, RE(PP(PLACEHOLDER_CONSTANT, TID_INT64)) },
+            { KW_COMPRESSION_LAYOUT, RE(PP(PLACEHOLDER_CONSTANT, TID_STRING)) },
+            { KW_COMPRESSION_FILTER, RE(PP(PLACEHOLDER_CONSTANT, TID_STRING)) },
+            { KW_INDEX_SPLIT,   RE(PP(PLACEHOLDER_CONSTANT, TID_INT64))  },
+            { KW_INDEX_PARTITION, RE(PP(PLACEHOLDER_CONSTANT, TID_INT64)) },
+            { KW_INDEX_FORMAT, RE(PP(PLACEHOLDER_CONSTANT, TID_STRING)) },
+            { KW_CHUNK_FANOUT, RE(PP(PLACEHOLDER_CONSTANT, TID_INT64)) },
+            { KW_PACK_SIZE, RE(PP(PLACEHOLDER_CONSTANT, TID_INT64)) }
         };
         return &argSpec;
     }
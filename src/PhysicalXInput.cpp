@@ -28,6 +28,7 @@
 #include "Driver.h"
 #include "XArray.h"
 #include "XIndex.h"
+#include "XInputCache.h"
 
 // SciDB
 #include <query/PhysicalOperator.h>
@@ -55,15 +56,50 @@ public:
             _parameters, _kwParameters, false, query);
 
         auto driver = Driver::makeDriver(settings->getURL());
+        auto &cache = XInputCache::getInstance();
+        const std::string &url = settings->getURL();
+        const size_t nInst = query->getInstancesCount();
+        const InstanceID instID = query->getInstanceID();
 
+        // Use Metadata Shipped by the Coordinator with the Plan
         std::shared_ptr<Metadata> metadata = std::make_shared<Metadata>();
-        driver->readMetadata(metadata);
+        std::string eTag;
+        if (settings->hasMetadata()) {
+            metadata->deserialize(settings->getMetadata());
+            eTag = settings->getETag();
+        }
+        else {
+            eTag = driver->getETag();
+            driver->readMetadata(metadata);
+        }
 
-        std::shared_ptr<XIndex> index = std::make_shared<XIndex>(_schema);
-        index->load(driver, query);
+        // Fence Index Is Read Lazily: Positions Are Looked Up in the
+        // Fence and Each Instance Loads Its Index When Chunks Are
+        // Iterated. The Metadata Is the Same on All Instances, so
+        // All Instances Skip the Cache.
+        if (metadata->getIndexFormat() == Metadata::IndexFormat::INDEX_FENCE) {
+            std::shared_ptr<XIndexFence> fence = std::make_shared<XIndexFence>(
+                _schema.getDimensions(), driver);
+
+            return std::make_shared<XArray>(
+                _schema, query, driver, nullptr, metadata,
+                settings->getCacheSize(), fence);
+        }
+
+        // Use Cached Index Only If All Instances Have It, Otherwise
+        // All Instances Load the Index
+        std::shared_ptr<const XIndex> index = cache.getIndex(
+            url, eTag, nInst, instID);
+        if (!XInputCache::allInstances(index != NULL, query)) {
+            std::shared_ptr<XIndex> newIndex = std::make_shared<XIndex>(
+                _schema, metadata->getPackSize() > 0);
+            newIndex->load(driver, query, metadata);
+            cache.setIndex(url, eTag, nInst, instID, newIndex);
+            index = newIndex;
+        }
 
         std::shared_ptr<XArray> array = std::make_shared<XArray>(
-            _schema, query, driver, index, metadata->getCompression(), settings->getCacheSize());
+            _schema, query, driver, index, metadata, settings->getCacheSize());
 
         return array;
     }
@@ -29,7 +29,12 @@
 #include "XArray.h"
 #include "XIndex.h"
 
+#include <algorithm>
+#include <cstring>
+#include <numeric>
+
 // SciDB
+#include <array/MemoryBuffer.h>
 #include <array/TileIteratorAdaptors.h>
 #include <network/Network.h>
 #include <query/PhysicalOperator.h>
@@ -45,12 +50,26 @@
 
 namespace scidb {
 
+// Codecs tried on each column for compression AUTO, from the fastest
+// to decode to the slowest
+static const Metadata::ColumnCompression AUTO_CANDIDATES[] = {
+    {Metadata::Compression::NONE, COMPRESSION_LEVEL_DEFAULT},
+    {Metadata::Compression::LZ4,  COMPRESSION_LEVEL_DEFAULT},
+    {Metadata::Compression::ZSTD, 1},
+    {Metadata::Compression::ZSTD, 9}
+};
+static const size_t AUTO_CANDIDATE_COUNT =
+    sizeof(AUTO_CANDIDATES) / sizeof(AUTO_CANDIDATES[0]);
+
 class ArrowWriter
 {
 private:
     const size_t                                      _nAttrs;
     const size_t                                      _nDims;
     const Metadata::Compression                       _compression;
+    std::unique_ptr<arrow::util::Codec>               _codec;
+    const Metadata::CompressionLayout                 _layout;
+    const Metadata::CompressionFilter                 _filter;
     std::vector<TypeEnum>                             _attrTypes;
     std::vector<std::vector<int64_t>>                 _dimValues;
 
@@ -61,14 +80,29 @@ private:
 
     arrow::MemoryPool*                                _arrowPool =
         arrow::default_memory_pool();
+    std::shared_ptr<arrow::ResizableBuffer>           _arrowColumnBuffer;
+    std::shared_ptr<arrow::ResizableBuffer>           _arrowShuffleBuffer;
+
+    // Compression AUTO (column layout only)
+    std::vector<std::unique_ptr<arrow::util::Codec>>  _columnCodecs;
+    std::vector<std::unique_ptr<arrow::util::Codec>>  _sampleCodecs;
+    std::vector<int64_t>                              _sampleSizes;
+    std::vector<std::vector<std::shared_ptr<arrow::Array>>> _deferredArrays;
 
 public:
     ArrowWriter(const Attributes &attributes,
                 const Dimensions &dimensions,
-                const Metadata::Compression compression):
+                const Metadata::Compression compression,
+                int compressionLevel=COMPRESSION_LEVEL_DEFAULT,
+                const Metadata::CompressionLayout layout=Metadata::LAYOUT_STREAM,
+                const Metadata::CompressionFilter filter=Metadata::FILTER_NONE):
         _nAttrs(attributes.size()),
         _nDims(dimensions.size()),
         _compression(compression),
+        _codec(compression == Metadata::Compression::AUTO ?
+               NULL : ArrowReader::makeCodec(compression, compressionLevel)),
+        _layout(layout),
+        _filter(filter),
         _attrTypes(_nAttrs),
         _dimValues(_nDims),
 
@@ -91,6 +125,69 @@ public:
                                             _arrowSchema->field(i)->type(),
                                             &_arrowBuilders[i]));
         }
+
+        THROW_NOT_OK(arrow::AllocateResizableBuffer(
+                         _arrowPool, 0, &_arrowColumnBuffer));
+        THROW_NOT_OK(arrow::AllocateResizableBuffer(
+                         _arrowPool, 0, &_arrowShuffleBuffer));
+
+        if (_compression == Metadata::Compression::AUTO) {
+            for (const auto &candidate : AUTO_CANDIDATES)
+                _sampleCodecs.push_back(ArrowReader::makeCodec(
+                                            candidate.compression,
+                                            candidate.level));
+            _sampleSizes.resize((_nAttrs + _nDims) * AUTO_CANDIDATE_COUNT, 0);
+        }
+    }
+
+    // Compression AUTO: until the column codecs are set, finalize
+    // keeps the Arrow Arrays, adds the size of each column compressed
+    // with each of AUTO_CANDIDATES to the sample sizes, and returns a
+    // NULL buffer. The kept arrays are written by finalizeDeferred.
+    bool isSampling() const {
+        return _compression == Metadata::Compression::AUTO
+            && _columnCodecs.empty();
+    }
+
+    size_t getDeferredCount() const {
+        return _deferredArrays.size();
+    }
+
+    // Stored size of column i with candidate c is at
+    // i * AUTO_CANDIDATE_COUNT + c
+    const std::vector<int64_t>& getSampleSizes() const {
+        return _sampleSizes;
+    }
+
+    void setColumnCompression(
+        const std::vector<Metadata::ColumnCompression> &columnCompression) {
+        if (columnCompression.size() != _nAttrs + _nDims) {
+            std::ostringstream error;
+            error << "Number of column codecs " << columnCompression.size()
+                  << " does not match the number of columns "
+                  << _nAttrs + _nDims;
+            throw SYSTEM_EXCEPTION(SCIDB_SE_METADATA, SCIDB_LE_ILLEGAL_OPERATION)
+                << error.str();
+        }
+        _columnCodecs.clear();
+        for (const auto &column : columnCompression)
+            _columnCodecs.push_back(ArrowReader::makeCodec(column.compression,
+                                                           column.level));
+    }
+
+    // Write the Arrow Arrays kept while sampling, in order
+    arrow::Status finalizeDeferred(
+        std::vector<std::shared_ptr<arrow::Buffer> > &arrowBuffers) {
+        for (auto &arrowArrays : _deferredArrays) {
+            _arrowArrays = std::move(arrowArrays);
+            std::shared_ptr<arrow::Buffer> arrowBuffer;
+            ARROW_RETURN_NOT_OK(finalizeColumns(arrowBuffer));
+            arrowBuffers.push_back(arrowBuffer);
+        }
+        _deferredArrays.clear();
+        _arrowArrays.resize(_nAttrs + _nDims);
+
+        return arrow::Status::OK();
     }
 
     arrow::Status writeArrowBuffer(const std::vector<std::shared_ptr<ConstChunkIterator> > &chunkIters,
@@ -412,12 +509,53 @@ public:
         return finalize(arrowBuffer);
     }
 
+    // Write index coordinates followed by the chunk locations of a
+    // packed index. The writer dimensions are the index dimensions
+    // (see XIndex::getIndexDimensions).
+    arrow::Status writeArrowBuffer(const XIndexStore::const_iterator begin,
+                                   const XIndexStore::const_iterator end,
+                                   const size_t size,
+                                   const XIndex &index,
+                                   std::shared_ptr<arrow::Buffer>& arrowBuffer) {
+        if (!index.isPacked())
+            return writeArrowBuffer(begin, end, size, arrowBuffer);
+
+        const size_t nDims = _nDims - XINDEX_LOCATION_SIZE;
+        for (auto posPtr = begin; posPtr != end && posPtr != begin + size; ++posPtr) {
+            for (size_t i = 0; i < nDims; ++i)
+                ARROW_RETURN_NOT_OK(
+                    static_cast<arrow::Int64Builder*>(
+                        _arrowBuilders[i].get())->Append((*posPtr)[i]));
+
+            auto location = index.getLocation(*posPtr);
+            const int64_t values[] = {
+                location->pack, location->offset, location->length};
+            for (size_t i = 0; i < XINDEX_LOCATION_SIZE; ++i)
+                ARROW_RETURN_NOT_OK(
+                    static_cast<arrow::Int64Builder*>(
+                        _arrowBuilders[nDims + i].get())->Append(values[i]));
+        }
+
+        return finalize(arrowBuffer);
+    }
+
     arrow::Status finalize(std::shared_ptr<arrow::Buffer>& arrowBuffer) {
         // Finalize Arrow Builders and write Arrow Arrays (resets builders)
         for (size_t i = 0; i < _nAttrs + _nDims; ++i)
             ARROW_RETURN_NOT_OK(
                 _arrowBuilders[i]->Finish(&_arrowArrays[i])); // Resets Builder!
 
+        // Keep the Arrow Arrays Until the Column Codecs Are Chosen
+        if (isSampling()) {
+            ARROW_RETURN_NOT_OK(sampleColumns());
+            _deferredArrays.push_back(_arrowArrays);
+            arrowBuffer.reset();
+            return arrow::Status::OK();
+        }
+
+        if (_layout == Metadata::CompressionLayout::LAYOUT_COLUMN)
+            return finalizeColumns(arrowBuffer);
+
         // Create Arrow Record Batch
         std::shared_ptr<arrow::RecordBatch> arrowBatch;
         arrowBatch = arrow::RecordBatch::Make(
@@ -433,14 +571,14 @@ public:
             arrow::io::BufferOutputStream::Create(4096, _arrowPool));
 
         // Setup Arrow Compression, If Enabled
+        const bool isStream = (_codec != NULL
+                               && !ArrowReader::isBlockCompression(_compression));
         std::shared_ptr<arrow::ipc::RecordBatchWriter> arrowWriter;
         std::shared_ptr<arrow::io::CompressedOutputStream> arrowCompressedStream;
-        if (_compression == Metadata::Compression::GZIP) {
-            std::unique_ptr<arrow::util::Codec> codec = *arrow::util::Codec::Create(
-                arrow::Compression::type::GZIP);
+        if (isStream) {
             ARROW_ASSIGN_OR_RAISE(
                 arrowCompressedStream,
-                arrow::io::CompressedOutputStream::Make(codec.get(), arrowBufferStream));
+                arrow::io::CompressedOutputStream::Make(_codec.get(), arrowBufferStream));
             ARROW_RETURN_NOT_OK(
                 arrow::ipc::RecordBatchStreamWriter::Open(
                     &*arrowCompressedStream, _arrowSchema, &arrowWriter));
@@ -459,10 +597,103 @@ public:
         ARROW_RETURN_NOT_OK(arrowWriter->Close());
 
         // Close Arrow Compression Stream, If Enabled
-        if (_compression == Metadata::Compression::GZIP) {
+        if (isStream) {
             ARROW_RETURN_NOT_OK(arrowCompressedStream->Close());
         }
 
+        ARROW_ASSIGN_OR_RAISE(arrowBuffer, arrowBufferStream->Finish());
+
+        // Compress Stream in One Block, If Enabled (see
+        // ArrowReader::isBlockCompression)
+        if (_codec != NULL && !isStream) {
+            const int64_t length = arrowBuffer->size();
+            const int64_t maxLength = _codec->MaxCompressedLen(
+                length, arrowBuffer->data());
+            std::shared_ptr<arrow::ResizableBuffer> blockBuffer;
+            ARROW_RETURN_NOT_OK(arrow::AllocateResizableBuffer(
+                                    _arrowPool,
+                                    sizeof(length) + maxLength,
+                                    &blockBuffer));
+            std::memcpy(blockBuffer->mutable_data(), &length, sizeof(length));
+            int64_t blockLength;
+            ARROW_ASSIGN_OR_RAISE(
+                blockLength,
+                _codec->Compress(length,
+                                 arrowBuffer->data(),
+                                 maxLength,
+                                 blockBuffer->mutable_data() + sizeof(length)));
+            ARROW_RETURN_NOT_OK(blockBuffer->Resize(sizeof(length) + blockLength));
+            arrowBuffer = blockBuffer;
+        }
+        LOG4CXX_DEBUG(logger, "XSAVE|arrowBuffer::size: " << arrowBuffer->size());
+
+        return arrow::Status::OK();
+    }
+
+    // Write the finished Arrow Arrays in column layout (see
+    // ARROW_COLUMN_MAGIC in XIndex.h), compressing each buffer on its
+    // own. Buffers which do not compress are stored as is.
+    arrow::Status finalizeColumns(std::shared_ptr<arrow::Buffer>& arrowBuffer) {
+        std::shared_ptr<arrow::io::BufferOutputStream> arrowBufferStream;
+        ARROW_ASSIGN_OR_RAISE(
+            arrowBufferStream,
+            arrow::io::BufferOutputStream::Create(4096, _arrowPool));
+
+        int64_t position = 0;
+        auto write = [&](const void *data, int64_t length) {
+            position += length;
+            return arrowBufferStream->Write(data, length);
+        };
+        auto writeInt64 = [&](int64_t value) {
+            return write(&value, sizeof(value));
+        };
+        const int64_t padding = 0;
+
+        std::vector<int64_t> offsets(1, 0);
+        std::vector<int64_t> nullCounts;
+        for (size_t i = 0; i < _arrowArrays.size(); ++i) {
+            const auto &arrowArray = _arrowArrays[i];
+            const auto &buffers = arrowArray->data()->buffers;
+            arrow::util::Codec *codec = _columnCodecs.empty() ?
+                _codec.get() : _columnCodecs[i].get();
+            ARROW_RETURN_NOT_OK(writeInt64(buffers.size()));
+            for (size_t j = 0; j < buffers.size(); ++j) {
+                const auto &buffer = buffers[j];
+                if (buffer == NULL) {
+                    ARROW_RETURN_NOT_OK(writeInt64(-1));
+                    ARROW_RETURN_NOT_OK(writeInt64(0));
+                    continue;
+                }
+
+                // Compress Buffer, Keep It Only If Smaller
+                int64_t storedLength;
+                ARROW_RETURN_NOT_OK(
+                    compressColumnBuffer(
+                        codec,
+                        *buffer,
+                        ArrowReader::filterWidth(_filter, *arrowArray->type(), j),
+                        storedLength));
+                const uint8_t *stored = storedLength < buffer->size() ?
+                    _arrowColumnBuffer->data() : buffer->data();
+
+                ARROW_RETURN_NOT_OK(writeInt64(buffer->size()));
+                ARROW_RETURN_NOT_OK(writeInt64(storedLength));
+                ARROW_RETURN_NOT_OK(write(stored, storedLength));
+                ARROW_RETURN_NOT_OK(write(&padding, (8 - storedLength % 8) % 8));
+            }
+            offsets.push_back(position);
+            nullCounts.push_back(arrowArray->null_count());
+        }
+
+        // Write Footer
+        for (auto offset : offsets)
+            ARROW_RETURN_NOT_OK(writeInt64(offset));
+        for (auto nullCount : nullCounts)
+            ARROW_RETURN_NOT_OK(writeInt64(nullCount));
+        ARROW_RETURN_NOT_OK(writeInt64(_arrowArrays[0]->length()));
+        ARROW_RETURN_NOT_OK(writeInt64(_arrowArrays.size()));
+        ARROW_RETURN_NOT_OK(write(ARROW_COLUMN_MAGIC, sizeof(ARROW_COLUMN_MAGIC) - 1));
+
         ARROW_ASSIGN_OR_RAISE(arrowBuffer, arrowBufferStream->Finish());
         LOG4CXX_DEBUG(logger, "XSAVE|arrowBuffer::size: " << arrowBuffer->size());
 
@@ -470,6 +701,62 @@ public:
     }
 
 private:
+    // Compress the buffer into _arrowColumnBuffer, shuffled first if
+    // the filter width is not 0. Sets the stored length, the buffer
+    // size if it does not compress.
+    arrow::Status compressColumnBuffer(arrow::util::Codec *codec,
+                                       const arrow::Buffer &buffer,
+                                       int filterWidth,
+                                       int64_t &storedLength) {
+        storedLength = buffer.size();
+        if (codec == NULL || buffer.size() == 0)
+            return arrow::Status::OK();
+
+        const uint8_t *data = buffer.data();
+        if (filterWidth > 0) {
+            ARROW_RETURN_NOT_OK(_arrowShuffleBuffer->Resize(buffer.size(), false));
+            ArrowReader::shuffle(_filter,
+                                 filterWidth,
+                                 buffer.data(),
+                                 buffer.size(),
+                                 _arrowShuffleBuffer->mutable_data());
+            data = _arrowShuffleBuffer->data();
+        }
+
+        const int64_t maxLength = codec->MaxCompressedLen(buffer.size(), data);
+        ARROW_RETURN_NOT_OK(_arrowColumnBuffer->Resize(maxLength, false));
+        int64_t length;
+        ARROW_ASSIGN_OR_RAISE(
+            length,
+            codec->Compress(buffer.size(),
+                            data,
+                            maxLength,
+                            _arrowColumnBuffer->mutable_data()));
+        storedLength = std::min(length, storedLength);
+        return arrow::Status::OK();
+    }
+
+    // Add the stored size of each column with each candidate codec
+    arrow::Status sampleColumns() {
+        for (size_t i = 0; i < _arrowArrays.size(); ++i) {
+            const auto &buffers = _arrowArrays[i]->data()->buffers;
+            for (size_t j = 0; j < buffers.size(); ++j) {
+                if (buffers[j] == NULL)
+                    continue;
+                const int width = ArrowReader::filterWidth(
+                    _filter, *_arrowArrays[i]->type(), j);
+                for (size_t c = 0; c < AUTO_CANDIDATE_COUNT; ++c) {
+                    int64_t storedLength;
+                    ARROW_RETURN_NOT_OK(
+                        compressColumnBuffer(
+                            _sampleCodecs[c].get(), *buffers[j], width, storedLength));
+                    _sampleSizes[i * AUTO_CANDIDATE_COUNT + c] += storedLength;
+                }
+            }
+        }
+        return arrow::Status::OK();
+    }
+
     template <typename ArrowBuilder,
               typename ValueFunc> inline
     arrow::Status writeValue(const Value& value, ValueFunc valueGetter, const size_t attrIdx) {
@@ -518,6 +805,64 @@ private:
     }
 };
 
+// Pack chunk objects into pack objects of about packSize bytes. Packs
+// written by instance instID are numbered instID, instID + nInst,
+// instID + 2 * nInst, etc.
+class PackWriter
+{
+public:
+    PackWriter(DriverWriteQueue &writes,
+               size_t packSize,
+               size_t chunkFanout,
+               InstanceID instID,
+               size_t nInst):
+        _writes(writes),
+        _packSize(packSize),
+        _chunkFanout(chunkFanout),
+        _nInst(nInst),
+        _packID(instID),
+        _offset(0)
+    {}
+
+    // Add the chunk object to the current pack. Returns its location.
+    XChunkLocation write(std::shared_ptr<arrow::Buffer> arrowBuffer) {
+        XChunkLocation location{_packID, _offset, arrowBuffer->size()};
+        _buffers.push_back(arrowBuffer);
+        _offset += arrowBuffer->size();
+        if (static_cast<size_t>(_offset) >= _packSize)
+            flush();
+        return location;
+    }
+
+    // Write the current pack, if not empty
+    void flush() {
+        if (_buffers.empty())
+            return;
+
+        std::shared_ptr<arrow::Buffer> packBuffer;
+        THROW_NOT_OK(arrow::ConcatenateBuffers(
+                         _buffers, arrow::default_memory_pool(), &packBuffer));
+        _writes.write(Metadata::packObjectName(_packID, _chunkFanout),
+                      packBuffer);
+        LOG4CXX_DEBUG(logger, "XSAVE|pack id:" << _packID
+                      << " nChunks:" << _buffers.size()
+                      << " size:" << _offset);
+
+        _buffers.clear();
+        _packID += _nInst;
+        _offset = 0;
+    }
+
+private:
+    DriverWriteQueue &_writes;
+    const size_t _packSize;
+    const size_t _chunkFanout;
+    const size_t _nInst;
+    int64_t _packID;
+    int64_t _offset;
+    std::vector<std::shared_ptr<arrow::Buffer> > _buffers;
+};
+
 class PhysicalXSave : public PhysicalOperator
 {
 public:
@@ -570,9 +915,15 @@ public:
                       << " haveChunk " << haveChunk_);
 
         // Chunk Coordinate Index
-        std::shared_ptr<XIndex> index = std::make_shared<XIndex>(inputSchema);
+        std::shared_ptr<XIndex> index = std::make_shared<XIndex>(
+            inputSchema, _settings->getPackSize() > 0);
+        // Index Used to Find Existing Chunks On Update Queries
+        std::shared_ptr<XIndex> existingIndex = index;
+        // Existing Fence Index, Searched Lazily On Update Queries
+        std::shared_ptr<XIndexFence> fence;
         std::shared_ptr<Metadata> metadataPtr = std::make_shared<Metadata>();
         Metadata &metadata = *metadataPtr; // Easier to Use with "[]"
+        const Dimensions &dims = inputSchema.getDimensions();
 
         // If Update, Read metadata and check that it matches
         if (_settings->isUpdate()) {
@@ -643,9 +994,38 @@ public:
 
             // Set compressio from Existing Metadata
             _settings->setCompression(metadata.getCompression());
+            _settings->setCompressionLevel(metadata.getCompressionLevel());
+            _settings->setCompressionLayout(metadata.getCompressionLayout());
+            _settings->setCompressionFilter(metadata.getCompressionFilter());
+            _settings->setColumnCompression(metadata.getColumnCompression());
+
+            // Set index_partition from Existing Metadata
+            _settings->setIndexPartition(metadata.getIndexPartition());
 
-            // Load Index
-            index->load(_driver, query);
+            // Set index_format from Existing Metadata
+            _settings->setIndexFormat(metadata.getIndexFormat());
+
+            // Set chunk_fanout from Existing Metadata
+            _settings->setChunkFanout(metadata.getChunkFanout());
+
+            // Packed Chunks Cannot Be Replaced In Place
+            if (metadata.getPackSize() > 0) {
+                error << "Update of packed array not supported";
+                throw USER_EXCEPTION(SCIDB_SE_ARRAY_WRITER,
+                                     SCIDB_LE_ILLEGAL_OPERATION) << error.str();
+            }
+
+            if (_settings->getIndexFormat()
+                == Metadata::IndexFormat::INDEX_FENCE) {
+                // Only Look Up Input Chunks in the Fence Index. The
+                // Existing Index Holds Existing Chunks Found So Far,
+                // the Index Holds New Chunks Only
+                fence = std::make_shared<XIndexFence>(dims, _driver);
+                existingIndex = std::make_shared<XIndex>(inputSchema);
+            }
+            else
+                // Load Index
+                index->load(_driver, query, metadataPtr);
         }
         else
             // New Array
@@ -659,12 +1039,32 @@ public:
                 metadata["version"] = STR(BRIDGE_VERSION);
                 metadata.setSchema(inputSchema);
                 metadata.setCompression(_settings->getCompression());
+                metadata.setCompressionLevel(_settings->getCompressionLevel());
+                metadata.setCompressionLayout(_settings->getCompressionLayout());
+                metadata.setCompressionFilter(_settings->getCompressionFilter());
+                metadata.setIndexFormat(_settings->getIndexFormat());
+                metadata.setChunkFanout(_settings->getChunkFanout());
+                metadata.setPackSize(_settings->getPackSize());
 
                 // Write Metadata
                 _driver->writeMetadata(metadataPtr);
             }
 
-        const Dimensions &dims = inputSchema.getDimensions();
+        // Compression AUTO: Choose the Column Codecs Once All the
+        // Instances Sampled Their First Chunks. Coordinator Records
+        // Them in the Metadata.
+        const bool isAuto = _settings->getCompression()
+            == Metadata::Compression::AUTO
+            && _settings->getColumnCompression().empty();
+        auto chooseCompression = [&](const std::vector<int64_t> &sampleSizes) {
+            _settings->setColumnCompression(
+                chooseColumnCompression(sampleSizes, query));
+            if (query->isCoordinator()) {
+                metadata.setColumnCompression(_settings->getColumnCompression());
+                _driver->writeMetadata(metadataPtr);
+            }
+        };
+
         if (haveChunk_) {
             // Init Array & Chunk Iterators
             size_t const nAttrs = inputSchema.getAttributes(true).size();
@@ -689,8 +1089,8 @@ public:
                     inputSchema,
                     query,
                     _driver,
-                    index,
-                    _settings->getCompression(), 0);
+                    existingIndex,
+                    metadataPtr, 0);
                 for (auto const &attr : inputSchema.getAttributes(true))
                     existingArrayIters[attr.getId()] =
                         existingArray->getConstIterator(attr);
@@ -699,7 +1099,44 @@ public:
             // if (_settings->isArrowFormat())
             ArrowWriter dataWriter(inputSchema.getAttributes(true),
                                    inputSchema.getDimensions(),
-                                   _settings->getCompression());
+                                   _settings->getCompression(),
+                                   _settings->getCompressionLevel(),
+                                   _settings->getCompressionLayout(),
+                                   _settings->getCompressionFilter());
+            if (!_settings->getColumnCompression().empty())
+                dataWriter.setColumnCompression(_settings->getColumnCompression());
+
+            // Write Chunks While Serializing the Next Ones
+            DriverWriteQueue chunkWrites(_driver);
+            PackWriter packWriter(chunkWrites,
+                                  _settings->getPackSize(),
+                                  _settings->getChunkFanout(),
+                                  instID,
+                                  query->getInstancesCount());
+            auto writeChunk = [&](const Coordinates &pos,
+                                  std::shared_ptr<arrow::Buffer> arrowBuffer) {
+                if (index->isPacked())
+                    // Add Chunk Coordinates and Location to Current Index
+                    index->insert(pos, packWriter.write(arrowBuffer));
+                else
+                    chunkWrites.write(
+                        Metadata::chunkObjectName(
+                            pos, dims, _settings->getChunkFanout()),
+                        arrowBuffer);
+            };
+
+            // Chunks Kept by the Writer While Sampling
+            std::vector<Coordinates> deferredPos;
+            auto writeDeferred = [&]() {
+                chooseCompression(dataWriter.getSampleSizes());
+                dataWriter.setColumnCompression(_settings->getColumnCompression());
+
+                std::vector<std::shared_ptr<arrow::Buffer> > arrowBuffers;
+                THROW_NOT_OK(dataWriter.finalizeDeferred(arrowBuffers));
+                for (size_t i = 0; i < arrowBuffers.size(); ++i)
+                    writeChunk(deferredPos[i], arrowBuffers[i]);
+                deferredPos.clear();
+            };
 
             while (!inputArrayIters[0]->end()) {
                 if (!inputArrayIters[0]->getChunk().getConstIterator(
@@ -717,6 +1154,10 @@ public:
                     // Declare Output;
                     std::shared_ptr<arrow::Buffer> arrowBuffer;
 
+                    // Add Chunk to Existing Index If Found in Fence
+                    if (fence && fence->contains(pos))
+                        existingIndex->insertSorted(pos);
+
                     // -- -
                     // Merge Chunks
                     // -- -
@@ -798,7 +1239,7 @@ public:
                         if (_settings->isUpdate())
                             // Add Chunk Coordinates to Extra Index (Update Query)
                             extraIndex->insert(pos);
-                        else
+                        else if (!index->isPacked())
                             // Add Chunk Coordinates to Current Index
                             index->insert(pos);
 
@@ -808,20 +1249,39 @@ public:
                                 inputChunkIters, arrowBuffer));
                     }
 
-                    // Write Chunk
-                    _driver->writeArrow(
-                        "chunks/" +
-                        Metadata::coord2ObjectName(pos, dims), arrowBuffer);
+                    // Write Chunk, Unless Kept for Sampling
+                    if (arrowBuffer == NULL) {
+                        deferredPos.push_back(pos);
+                        if (deferredPos.size() == AUTO_SAMPLE_CHUNKS)
+                            writeDeferred();
+                    }
+                    else
+                        writeChunk(pos, arrowBuffer);
                 }
 
                 // Advance Array Iterators
                 for(size_t i =0; i < nAttrs; ++i) ++(*inputArrayIters[i]);
             }
 
+            // Fewer Chunks Than Sampled
+            if (dataWriter.isSampling())
+                writeDeferred();
+
+            // All Chunks Are Written and Durable Before the Index
+            packWriter.flush();
+            chunkWrites.wait();
+            _driver->flush();
+
             if (extraIndex->size() > 0)
                 // Append New Chunks to Current Index
                 index->insert(*extraIndex);
         }
+        else if (isAuto)
+            // Instances Without Chunks Take Part in the Choice
+            chooseCompression(std::vector<int64_t>(
+                                  (inputSchema.getAttributes(true).size()
+                                   + dims.size()) * AUTO_CANDIDATE_COUNT,
+                                  0));
 
         // Centralize Index
         if (query->isCoordinator()) {
@@ -832,6 +1292,20 @@ public:
                     // Receive and De-Serialize Index
                     index->deserialize_insert(BufReceive(remoteID, query));
 
+            // Add Existing Chunks From Fence Index
+            if (fence) {
+                Coordinates pos(dims.size());
+                std::vector<size_t> iObjects(fence->getObjectCount());
+                std::iota(iObjects.begin(), iObjects.end(), 0);
+                fence->readObjects(
+                    iObjects, [&](const int64_t *record, size_t nRecords) {
+                        for (size_t j = 0; j < nRecords; ++j, record += dims.size()) {
+                            std::copy(record, record + dims.size(), pos.begin());
+                            index->insert(pos);
+                        }
+                    });
+            }
+
             // Sort Index
             index->sort();
 
@@ -844,32 +1318,60 @@ public:
                           << "|execute szSplit:" << szSplit);
 
             ArrowWriter indexWriter(Attributes(),
-                                    inputSchema.getDimensions(),
+                                    XIndex::getIndexDimensions(
+                                        inputSchema.getDimensions(),
+                                        index->isPacked()),
                                     Metadata::Compression::GZIP);
+            DriverWriteQueue indexWrites(_driver);
+
+            size_t nPart = _settings->getIndexPartition();
+            if (_settings->getIndexFormat()
+                == Metadata::IndexFormat::INDEX_FENCE)
+                XIndexFence::write(_driver, nDims, index->begin(), index->end(),
+                                   _settings->getIndexSplit());
+            else if (nPart == 0) {
+                writeIndex(indexWriter, indexWrites, *index,
+                           index->begin(), index->end(), szSplit, split);
+                indexWrites.wait();
+            }
+            else {
+                // Partition Index Using the Distribution Used by
+                // xinput for the Specified Number of Instances
+                ArrayDesc partSchema(inputSchema);
+                partSchema.setDistribution(
+                    createDistribution(defaultDistType()));
+
+                std::vector<XIndexStore> parts(nPart);
+                for (auto posPtr = index->begin(); posPtr != index->end(); ++posPtr)
+                    parts[partSchema.getPrimaryInstanceId(*posPtr, nPart)].push_back(*posPtr);
+
+                // Write Each Partition in Its Own Index Splits
+                std::vector<size_t> partSplit;
+                for (const auto &part : parts) {
+                    partSplit.push_back(split);
+                    writeIndex(indexWriter, indexWrites, *index,
+                               part.begin(), part.end(), szSplit, split);
+                }
+                partSplit.push_back(split);
+                indexWrites.wait();
 
-            auto splitPtr = index->begin();
-            while (splitPtr != index->end()) {
-                // Convert to Arrow
-                std::shared_ptr<arrow::Buffer> arrowBuffer;
-                THROW_NOT_OK(indexWriter.writeArrowBuffer(splitPtr,
-                                                          index->end(),
-                                                          szSplit,
-                                                          arrowBuffer));
-
-                // Write Index
-                std::ostringstream out;
-                out << "index/" << split;
-                _driver->writeArrow(out.str(), arrowBuffer);
-
-                // Advance to Next Index Split
-                splitPtr += std::min<size_t>(
-                    szSplit,
-                    std::distance(splitPtr, index->end()));
-                split++;
+                LOG4CXX_DEBUG(logger, "XSAVE|" << instID
+                              << "|execute nPart:" << nPart
+                              << " nSplit:" << split);
+
+                // Record Partitions in Metadata
+                metadata.setIndexPartition(nPart, partSplit);
+                _driver->writeMetadata(metadataPtr);
             }
+
+            // Index and Metadata Are Durable
+            _driver->flush();
         }
-        else
+        else {
+            // Sorted Index Encodes Best
+            index->sort();
             BufSend(query->getCoordinatorID(), index->serialize(), query);
+        }
 
         return result;
     }
@@ -878,6 +1380,91 @@ private:
     std::shared_ptr<XSaveSettings> _settings;
     std::shared_ptr<Driver> _driver;
 
+    // Add up the sample sizes of all the instances and choose, for
+    // each column, the fastest of AUTO_CANDIDATES which is within
+    // AUTO_GAIN_MIN of the smallest size. Columns which do not
+    // compress by AUTO_GAIN_MIN are not compressed. All the instances
+    // make the same choice.
+    std::vector<Metadata::ColumnCompression> chooseColumnCompression(
+        std::vector<int64_t> sampleSizes,
+        std::shared_ptr<Query> query) {
+        const InstanceID instID = query->getInstanceID();
+        const size_t nInst = query->getInstancesCount();
+        const size_t size = sampleSizes.size() * sizeof(int64_t);
+
+        // Exchange Sample Sizes
+        std::shared_ptr<SharedBuffer> buf(
+            new MemoryBuffer(sampleSizes.data(), size));
+        for (InstanceID remoteID = 0; remoteID < nInst; ++remoteID)
+            if (remoteID != instID)
+                BufSend(remoteID, buf, query);
+
+        for (InstanceID remoteID = 0; remoteID < nInst; ++remoteID)
+            if (remoteID != instID) {
+                auto remoteBuf = BufReceive(remoteID, query);
+                if (remoteBuf->getSize() != size)
+                    throw SYSTEM_EXCEPTION(SCIDB_SE_NETWORK,
+                                           SCIDB_LE_UNKNOWN_ERROR)
+                        << "Sample sizes do not match between instances";
+                const int64_t *remoteSizes = static_cast<const int64_t*>(
+                    remoteBuf->getConstData());
+                for (size_t i = 0; i < sampleSizes.size(); ++i)
+                    sampleSizes[i] += remoteSizes[i];
+            }
+
+        // Choose Codecs
+        const size_t nColumns = sampleSizes.size() / AUTO_CANDIDATE_COUNT;
+        std::vector<Metadata::ColumnCompression> columnCompression;
+        for (size_t i = 0; i < nColumns; ++i) {
+            const int64_t *sizes = &sampleSizes[i * AUTO_CANDIDATE_COUNT];
+            const int64_t minSize = *std::min_element(
+                sizes, sizes + AUTO_CANDIDATE_COUNT);
+            size_t c = 0;
+            while (sizes[c] > minSize * AUTO_GAIN_MIN)
+                ++c;
+            columnCompression.push_back(AUTO_CANDIDATES[c]);
+
+            LOG4CXX_DEBUG(logger, "XSAVE|" << instID
+                          << "|chooseColumnCompression column:" << i
+                          << " raw:" << sizes[0]
+                          << " stored:" << sizes[c]
+                          << " candidate:" << c);
+        }
+        return columnCompression;
+    }
+
+    // Write index coordinates in objects of szSplit coordinates
+    // each, starting with object number split
+    void writeIndex(ArrowWriter &indexWriter,
+                    DriverWriteQueue &indexWrites,
+                    const XIndex &index,
+                    const XIndexStore::const_iterator begin,
+                    const XIndexStore::const_iterator end,
+                    const size_t szSplit,
+                    size_t &split) {
+        auto splitPtr = begin;
+        while (splitPtr != end) {
+            // Convert to Arrow
+            std::shared_ptr<arrow::Buffer> arrowBuffer;
+            THROW_NOT_OK(indexWriter.writeArrowBuffer(splitPtr,
+                                                      end,
+                                                      szSplit,
+                                                      index,
+                                                      arrowBuffer));
+
+            // Write Index
+            std::ostringstream out;
+            out << "index/" << split;
+            indexWrites.write(out.str(), arrowBuffer);
+
+            // Advance to Next Index Split
+            splitPtr += std::min<size_t>(
+                szSplit,
+                std::distance(splitPtr, end));
+            split++;
+        }
+    }
+
     void writeFrom(std::vector<std::shared_ptr<ConstChunkIterator> > &sourceIters,
                    std::vector<std::shared_ptr<ChunkIterator> > &outputIters,
                    const size_t nAttrs,
@@ -24,19 +24,58 @@
 */
 
 #include "S3Driver.h"
+#include "Config.h"
 
 #include <log4cxx/logger.h>
+#include <algorithm>
+#include <atomic>
+#include <climits>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <future>
+#include <random>
 
 // AWS
+#include <aws/core/client/DefaultRetryStrategy.h>
 #include <aws/s3/S3Client.h>
+#include <aws/s3/model/AbortMultipartUploadRequest.h>
+#include <aws/s3/model/CompleteMultipartUploadRequest.h>
+#include <aws/s3/model/CreateMultipartUploadRequest.h>
 #include <aws/s3/model/GetObjectRequest.h>
 #include <aws/s3/model/HeadObjectRequest.h>
 #include <aws/s3/model/ListObjectsRequest.h>
+#include <aws/s3/model/ListObjectsV2Request.h>
 #include <aws/s3/model/PutObjectRequest.h>
+#include <aws/s3/model/UploadPartRequest.h>
 
 
-#define RETRY_COUNT 5
-#define RETRY_SLEEP 1000        // milliseconds
+#define RETRY_COUNT 5             // attempts
+#define RETRY_BASE 50             // milliseconds
+#define RETRY_BASE_THROTTLE 500   // milliseconds
+#define RETRY_CAP 20000           // milliseconds
+#define RETRY_BUDGET 500          // tokens
+#define RETRY_COST 5              // tokens
+#define RETRY_COST_THROTTLE 10    // tokens
+#define RETRY_REFUND 1            // tokens
+
+#define LIMITER_INIT 8            // requests
+#define CONCURRENCY_MAX 1024      // connections, requests, parts, ranges
+
+#define HEDGE_PERCENTILE 95
+#define HEDGE_MAX_OVERHEAD 5      // percent of GETs
+#define HEDGE_SAMPLES 1000        // GET latencies kept
+#define HEDGE_WARMUP 100          // GETs before hedging
+
+#define MULTIPART_THRESHOLD 67108864  // 64MB in Bytes
+#define MULTIPART_PART_SIZE 16777216  // 16MB in Bytes
+#define MULTIPART_PART_MIN_SIZE 5242880 // 5MB in Bytes, S3 minimum
+#define MULTIPART_PART_MAX_SIZE 5368709120 // 5GB in Bytes, S3 maximum
+#define MULTIPART_CONCURRENCY 8       // parts
+
+#define RANGE_SIZE 16777216       // 16MB in Bytes
+#define RANGE_CONCURRENCY 8       // ranges
 
 #define S3_EXCEPTION_NOT_SUCCESS(operation)                             \
     {                                                                   \
@@ -81,13 +120,683 @@ namespace scidb {
         std::mutex &_lock;
     };
 
+    //
+    // Retries
+    //
+    // Failed requests are classified as fatal (e.g., 403, 404),
+    // transient (5xx, timeouts, network errors), or throttling (503
+    // SlowDown, 429). Only the last two are retried, sleeping with
+    // decorrelated jitter, so instances failing together do not retry
+    // in lockstep. Each retry takes tokens from a process-wide budget
+    // and each success refunds some, so sustained failures stop
+    // retries instead of amplifying load.
+    enum class S3ErrorClass {
+        FATAL,
+        TRANSIENT,
+        THROTTLING
+    };
+
+    static S3ErrorClass classifyError(
+        const Aws::Client::AWSError<Aws::S3::S3Errors> &error)
+    {
+        auto code = error.GetResponseCode();
+        if (code == Aws::Http::HttpResponseCode::SERVICE_UNAVAILABLE
+            || code == Aws::Http::HttpResponseCode::TOO_MANY_REQUESTS
+            || error.GetErrorType() == Aws::S3::S3Errors::THROTTLING
+            || error.GetErrorType() == Aws::S3::S3Errors::SLOW_DOWN)
+            return S3ErrorClass::THROTTLING;
+
+        if (error.ShouldRetry()
+            || code == Aws::Http::HttpResponseCode::REQUEST_NOT_MADE
+            || code == Aws::Http::HttpResponseCode::REQUEST_TIMEOUT
+            || static_cast<int>(code) >= 500)
+            return S3ErrorClass::TRANSIENT;
+
+        return S3ErrorClass::FATAL;
+    }
+
+    static std::atomic<int64_t> s_retryBudget(RETRY_BUDGET);
+
+    static bool acquireRetryBudget(int64_t cost)
+    {
+        int64_t budget = s_retryBudget.load();
+        while (budget >= cost)
+            if (s_retryBudget.compare_exchange_weak(budget, budget - cost))
+                return true;
+        return false;
+    }
+
+    static void refundRetryBudget()
+    {
+        int64_t budget = s_retryBudget.load();
+        while (budget < RETRY_BUDGET
+               && !s_retryBudget.compare_exchange_weak(budget,
+                                                       budget + RETRY_REFUND))
+            ;
+    }
+
+    // Sleep between base and three times the previous sleep, capped
+    static int64_t decorrelatedJitter(int64_t base, int64_t previous)
+    {
+        thread_local std::mt19937_64 generator{std::random_device()()};
+        std::uniform_int_distribution<int64_t> distribution(
+            base, std::max(base, previous * 3));
+        return std::min<int64_t>(RETRY_CAP, distribution(generator));
+    }
+
+    // Process-wide counters, logged as metrics
+    static std::atomic<uint64_t> s_requests(0);
+    static std::atomic<uint64_t> s_retries(0);
+    static std::atomic<uint64_t> s_throttled(0);
+    static std::atomic<uint64_t> s_budgetExhausted(0);
+    static std::atomic<uint64_t> s_failed(0);
+    static std::atomic<uint64_t> s_hedged(0);
+
+    static void logMetrics(size_t limit)
+    {
+        LOG4CXX_INFO(logger, "S3DRIVER|metrics"
+                     << " requests:" << s_requests
+                     << " retries:" << s_retries
+                     << " throttled:" << s_throttled
+                     << " budget_exhausted:" << s_budgetExhausted
+                     << " failed:" << s_failed
+                     << " hedged:" << s_hedged
+                     << " budget:" << s_retryBudget
+                     << " concurrency:" << limit);
+    }
+
+    // Send request using a client method
+    template <typename RequestFunc, typename Request>
+    inline auto callRequest(const Aws::S3::S3Client &client,
+                            RequestFunc requestFunc,
+                            const Request &request)
+        -> decltype((client.*requestFunc)(request))
+    {
+        return (client.*requestFunc)(request);
+    }
+
+    // Rewind request body before each attempt, the previous attempt
+    // might have consumed it
+    template <typename Request>
+    inline void rewindBody(const Request&) {}
+
+    inline void rewindBody(const Aws::S3::Model::PutObjectRequest &request)
+    {
+        auto body = request.GetBody();
+        if (body) {
+            body->clear();
+            body->seekg(0);
+        }
+    }
+
+    inline void rewindBody(const Aws::S3::Model::UploadPartRequest &request)
+    {
+        auto body = request.GetBody();
+        if (body) {
+            body->clear();
+            body->seekg(0);
+        }
+    }
+
+    // Bytes sent in the request body, used by the limiter to compare
+    // latencies of requests of similar size
+    template <typename Request>
+    inline size_t requestBytes(const Request&) { return 0; }
+
+    inline size_t requestBytes(const Aws::S3::Model::PutObjectRequest &request)
+    {
+        auto body = request.GetBody();
+        if (!body)
+            return 0;
+        auto pos = body->tellg();
+        body->seekg(0, std::ios_base::end);
+        auto end = body->tellg();
+        body->seekg(pos);
+        return pos >= 0 && end > pos ? static_cast<size_t>(end - pos) : 0;
+    }
+
+    inline size_t requestBytes(const Aws::S3::Model::UploadPartRequest &request)
+    {
+        return request.GetContentLength();
+    }
+
+    // Bytes received in the response body
+    template <typename Outcome>
+    inline size_t responseBytes(const Outcome&) { return 0; }
+
+    inline size_t responseBytes(const Aws::S3::Model::GetObjectOutcome &outcome)
+    {
+        return outcome.IsSuccess() ? outcome.GetResult().GetContentLength() : 0;
+    }
+
+    //
+    // ArrowBufferStream
+    //
+    // Read-only stream over the memory of an Arrow buffer, used as the
+    // PutObject body to avoid copying the buffer. Seeking is supported
+    // since the SDK seeks to compute the content length and to rewind
+    // the body on retries.
+    class ArrowStreamBuf: public std::streambuf {
+    public:
+        ArrowStreamBuf(std::shared_ptr<const arrow::Buffer> buffer):
+            _buffer(buffer)
+        {
+            char *begin = const_cast<char*>(
+                reinterpret_cast<const char*>(_buffer->data()));
+            setg(begin, begin, begin + _buffer->size());
+        }
+
+    protected:
+        pos_type seekoff(off_type offset,
+                         std::ios_base::seekdir dir,
+                         std::ios_base::openmode which) override
+        {
+            if (dir == std::ios_base::cur)
+                offset += gptr() - eback();
+            else if (dir == std::ios_base::end)
+                offset += egptr() - eback();
+            return seekpos(offset, which);
+        }
+
+        pos_type seekpos(pos_type pos, std::ios_base::openmode which) override
+        {
+            if (!(which & std::ios_base::in)
+                || pos < 0
+                || pos > egptr() - eback())
+                return pos_type(off_type(-1));
+            setg(eback(), eback() + pos, egptr());
+            return pos;
+        }
+
+    private:
+        std::shared_ptr<const arrow::Buffer> _buffer;
+    };
+
+    class ArrowBufferStream: public Aws::IOStream {
+    public:
+        ArrowBufferStream(std::shared_ptr<const arrow::Buffer> buffer):
+            Aws::IOStream(NULL),
+            _streamBuf(buffer)
+        {
+            rdbuf(&_streamBuf);
+        }
+
+    private:
+        ArrowStreamBuf _streamBuf;
+    };
+
+    //
+    // ArrowResponseStream
+    //
+    // Response body stream writing into an Arrow buffer, so the SDK
+    // does not accumulate the body in its default stream first. The
+    // SDK creates a stream for each attempt, including hedged ones.
+    // One stream at a time owns the target buffer, the others write
+    // into their own buffer, which is copied into the target if their
+    // response is used. Once the target is closed, writes of late
+    // streams fail, which aborts their requests. Error responses are
+    // read back by the SDK, so the stream is also readable.
+    struct ArrowResponseTarget {
+        ArrowResponseTarget(std::shared_ptr<arrow::ResizableBuffer> buffer):
+            buffer(buffer),
+            owner(NULL),
+            closed(false)
+        {}
+
+        std::mutex lock;
+        std::shared_ptr<arrow::ResizableBuffer> buffer;
+        const void *owner;
+        bool closed;
+    };
+
+    class ArrowResponseStreamBuf: public std::streambuf {
+    public:
+        ArrowResponseStreamBuf(std::shared_ptr<ArrowResponseTarget> target):
+            _target(target),
+            _readPos(0)
+        {}
+
+        ~ArrowResponseStreamBuf()
+        {
+            ScopedMutex lock(_target->lock); // LOCK
+            if (_target->owner == this)
+                _target->owner = NULL;
+        }
+
+        // Close target and make sure it holds the body received by
+        // this stream. Return the body size.
+        size_t close()
+        {
+            ScopedMutex lock(_target->lock); // LOCK
+            _target->closed = true;
+
+            auto &buffer = _target->buffer;
+            if (_target->owner != this) {
+                int64_t length = _buffer ? _buffer->size() : 0;
+                THROW_NOT_OK(buffer->Resize(length, false));
+                if (length > 0)
+                    std::memcpy(buffer->mutable_data(), _buffer->data(), length);
+            }
+            return buffer->size();
+        }
+
+    protected:
+        std::streamsize xsputn(const char *data, std::streamsize length) override
+        {
+            ScopedMutex lock(_target->lock); // LOCK
+            if (_target->closed)
+                return 0;
+
+            // Take ownership of the target if free and not written yet
+            if (_target->owner == NULL && !_buffer) {
+                if (!_target->buffer->Resize(0, false).ok())
+                    return 0;
+                _target->owner = this;
+            }
+            if (_target->owner != this && !_buffer)
+                if (!arrow::AllocateResizableBuffer(0, &_buffer).ok())
+                    return 0;
+
+            // Grow geometrically, Arrow only rounds up to 64 bytes
+            auto &buffer = _target->owner == this ? _target->buffer : _buffer;
+            int64_t size = buffer->size();
+            if (size + length > buffer->capacity()
+                && !buffer->Reserve(
+                    std::max(buffer->capacity() * 2, size + length)).ok())
+                return 0;
+            if (!buffer->Resize(size + length, false).ok())
+                return 0;
+            std::memcpy(buffer->mutable_data() + size, data, length);
+            return length;
+        }
+
+        int_type overflow(int_type c) override
+        {
+            if (traits_type::eq_int_type(c, traits_type::eof()))
+                return traits_type::not_eof(c);
+            char ch = traits_type::to_char_type(c);
+            return xsputn(&ch, 1) == 1 ? c : traits_type::eof();
+        }
+
+        int_type underflow() override
+        {
+            ScopedMutex lock(_target->lock); // LOCK
+            auto &buffer = _target->owner == this ? _target->buffer : _buffer;
+            if (!buffer || _readPos >= buffer->size())
+                return traits_type::eof();
+
+            char *begin = reinterpret_cast<char*>(buffer->mutable_data());
+            setg(begin, begin + _readPos, begin + buffer->size());
+            _readPos = buffer->size();
+            return traits_type::to_int_type(*gptr());
+        }
+
+    private:
+        std::shared_ptr<ArrowResponseTarget> _target;
+        std::shared_ptr<arrow::ResizableBuffer> _buffer;
+        int64_t _readPos;
+    };
+
+    // Resizable buffer over a fixed memory region, used as target for
+    // range requests written in place into a larger buffer
+    class ArrowRegionBuffer: public arrow::ResizableBuffer {
+    public:
+        ArrowRegionBuffer(uint8_t *data, int64_t capacity):
+            arrow::ResizableBuffer(data, 0)
+        {
+            capacity_ = capacity;
+        }
+
+        arrow::Status Resize(const int64_t size, bool) override
+        {
+            if (size > capacity_)
+                return arrow::Status::CapacityError(
+                    "Range larger than region");
+            size_ = size;
+            return arrow::Status::OK();
+        }
+
+        arrow::Status Reserve(const int64_t capacity) override
+        {
+            if (capacity > capacity_)
+                return arrow::Status::CapacityError(
+                    "Range larger than region");
+            return arrow::Status::OK();
+        }
+    };
+
+    class ArrowResponseStream: public Aws::IOStream {
+    public:
+        ArrowResponseStream(std::shared_ptr<ArrowResponseTarget> target):
+            Aws::IOStream(NULL),
+            _streamBuf(target)
+        {
+            rdbuf(&_streamBuf);
+        }
+
+        size_t close() { return _streamBuf.close(); }
+
+    private:
+        ArrowResponseStreamBuf _streamBuf;
+    };
+
+    //
+    // S3Limiter
+    //
+    S3Limiter::S3Limiter(size_t initLimit, size_t maxLimit, bool adaptive):
+        _adaptive(adaptive),
+        _limit(adaptive ? initLimit : maxLimit, maxLimit),
+        _inFlight(0)
+    {}
+
+    void S3Limiter::acquire()
+    {
+        std::unique_lock<std::mutex> lock(_lock); // LOCK
+        _cond.wait(lock, [this]{
+                return _inFlight < static_cast<size_t>(_limit.getLimit()); });
+        _inFlight++;
+    }
+
+    void S3Limiter::release(bool success,
+                            bool throttled,
+                            std::chrono::microseconds latency,
+                            size_t bytes)
+    {
+        {
+            ScopedMutex lock(_lock); // LOCK
+            _inFlight--;
+
+            if (_adaptive) {
+                auto reason = _limit.update(
+                    success, throttled, latency, bytes,
+                    std::chrono::steady_clock::now());
+                if (reason)
+                    LOG4CXX_DEBUG(logger, "S3DRIVER|limiter " << reason
+                                  << " limit:" << _limit.getLimit()
+                                  << " in-flight:" << _inFlight
+                                  << " bytes:" << bytes);
+            }
+        }
+        _cond.notify_all();
+    }
+
+    bool S3Limiter::tryAcquire()
+    {
+        ScopedMutex lock(_lock); // LOCK
+        if (_inFlight >= static_cast<size_t>(_limit.getLimit()))
+            return false;
+        _inFlight++;
+        return true;
+    }
+
+    size_t S3Limiter::getLimit()
+    {
+        ScopedMutex lock(_lock); // LOCK
+        return static_cast<size_t>(_limit.getLimit());
+    }
+
+    //
+    // S3Hedge
+    //
+    S3Hedge::S3Hedge(double percentile, double maxOverhead):
+        _percentile(percentile),
+        _maxOverhead(maxOverhead),
+        _nGets(0),
+        _nHedges(0)
+    {
+        for (auto &samples : _samples) {
+            samples.latencies.reserve(HEDGE_SAMPLES);
+            samples.next = 0;
+        }
+    }
+
+    std::chrono::microseconds S3Hedge::getDelay(size_t length)
+    {
+        ScopedMutex lock(_lock); // LOCK
+        if (_percentile <= 0 || _maxOverhead <= 0)
+            return std::chrono::microseconds(0);
+
+        _nGets++;
+        if (length == 0)
+            return std::chrono::microseconds(0);
+
+        const auto &latencies = _samples[AIMDLimit::getClass(length)].latencies;
+        if (latencies.size() < HEDGE_WARMUP)
+            return std::chrono::microseconds(0);
+
+        std::vector<int64_t> samples(latencies);
+        auto nth = samples.begin() + static_cast<size_t>(
+            samples.size() * _percentile / 100);
+        if (nth == samples.end())
+            nth--;
+        std::nth_element(samples.begin(), nth, samples.end());
+        return std::chrono::microseconds(std::max<int64_t>(*nth, 1));
+    }
+
+    bool S3Hedge::acquire()
+    {
+        ScopedMutex lock(_lock); // LOCK
+        if (_nHedges + 1 > _maxOverhead / 100 * _nGets)
+            return false;
+        _nHedges++;
+        return true;
+    }
+
+    void S3Hedge::cancel()
+    {
+        ScopedMutex lock(_lock); // LOCK
+        _nHedges--;
+    }
+
+    void S3Hedge::record(std::chrono::microseconds latency, size_t length)
+    {
+        ScopedMutex lock(_lock); // LOCK
+        auto &samples = _samples[AIMDLimit::getClass(length)];
+        if (samples.latencies.size() < HEDGE_SAMPLES)
+            samples.latencies.push_back(latency.count());
+        else
+            samples.latencies[samples.next] = latency.count();
+        samples.next = (samples.next + 1) % HEDGE_SAMPLES;
+    }
+
+    // Length of the byte range of a GET, zero if it has no range
+    static size_t rangeLength(const Aws::S3::Model::GetObjectRequest &request)
+    {
+        unsigned long long first, last;
+        if (!request.RangeHasBeenSet()
+            || std::sscanf(request.GetRange().c_str(), "bytes=%llu-%llu",
+                           &first, &last) != 2
+            || last < first)
+            return 0;
+        return last - first + 1;
+    }
+
+    // Record the latency of a completed GET and release its in-flight
+    // slot
+    static void completeGet(std::shared_ptr<S3Limiter> limiter,
+                            std::shared_ptr<S3Hedge> hedge,
+                            const Aws::S3::Model::GetObjectOutcome &outcome,
+                            std::chrono::steady_clock::time_point start)
+    {
+        auto latency = std::chrono::duration_cast<std::chrono::microseconds>(
+            std::chrono::steady_clock::now() - start);
+        auto length = responseBytes(outcome);
+        if (outcome.IsSuccess())
+            hedge->record(latency, length);
+        limiter->release(
+            outcome.IsSuccess(),
+            !outcome.IsSuccess()
+            && classifyError(outcome.GetError()) == S3ErrorClass::THROTTLING,
+            latency,
+            length);
+    }
+
+    // Send GET and hedge it if it is slow. The GET holds the in-flight
+    // slot taken by the caller, the slot is released once the GET
+    // completes, which might be after a hedged GET is used.
+    static Aws::S3::Model::GetObjectOutcome hedgedGetObject(
+        std::shared_ptr<Aws::S3::S3Client> client,
+        std::shared_ptr<S3Limiter> limiter,
+        std::shared_ptr<S3Hedge> hedge,
+        const Aws::S3::Model::GetObjectRequest &request)
+    {
+        auto delay = hedge->getDelay(rangeLength(request));
+        if (delay.count() == 0) {
+            auto start = std::chrono::steady_clock::now();
+            auto outcome = client->GetObject(request);
+            completeGet(limiter, hedge, outcome, start);
+            return outcome;
+        }
+
+        // Responses are received on the client executor threads. The
+        // first successful response is used, or the last failed one if
+        // all fail. Late responses are dropped.
+        struct State {
+            std::mutex lock;
+            std::condition_variable cond;
+            size_t pending;
+            bool done;
+            Aws::S3::Model::GetObjectOutcome outcome;
+        };
+        auto state = std::make_shared<State>();
+        state->pending = 1;
+        state->done = false;
+
+        // Each request holds its own in-flight slot until its
+        // response is received, including the superseded one
+        auto send = [client, &request, state, hedge, limiter]() {
+            auto start = std::chrono::steady_clock::now();
+            client->GetObjectAsync(
+                request,
+                [state, hedge, limiter, start](
+                    const Aws::S3::S3Client*,
+                    const Aws::S3::Model::GetObjectRequest&,
+                    Aws::S3::Model::GetObjectOutcome outcome,
+                    const std::shared_ptr<const Aws::Client::AsyncCallerContext>&) {
+                    completeGet(limiter, hedge, outcome, start);
+                    {
+                        ScopedMutex lock(state->lock); // LOCK
+                        state->pending--;
+                        if (!state->done
+                            && (outcome.IsSuccess() || state->pending == 0)) {
+                            state->outcome = std::move(outcome);
+                            state->done = true;
+                        }
+                    }
+                    state->cond.notify_all();
+                });
+        };
+
+        send();
+
+        // The overhead is only used if an in-flight slot is available
+        std::unique_lock<std::mutex> lock(state->lock); // LOCK
+        if (!state->cond.wait_for(lock, delay, [&state]{ return state->done; })
+            && hedge->acquire()) {
+            if (limiter->tryAcquire()) {
+                LOG4CXX_DEBUG(logger, "S3DRIVER|Get hedge:" << request.GetKey()
+                              << " after:" << delay.count() << "us");
+                s_hedged++;
+                state->pending++;
+                lock.unlock();
+                send();
+                lock.lock();
+            }
+            else
+                hedge->cancel();
+        }
+        state->cond.wait(lock, [&state]{ return state->done; });
+
+        return std::move(state->outcome);
+    }
+
+    // Send request holding the in-flight slot taken by the caller and
+    // release the slot once the request completes
+    template <typename RequestFunc, typename Request>
+    inline auto sendRequest(std::shared_ptr<Aws::S3::S3Client> client,
+                            std::shared_ptr<S3Limiter> limiter,
+                            std::shared_ptr<S3Hedge>,
+                            RequestFunc requestFunc,
+                            const Request &request)
+        -> decltype(callRequest(*client, requestFunc, request))
+    {
+        size_t bytes = requestBytes(request);
+        auto start = std::chrono::steady_clock::now();
+        auto result = callRequest(*client, requestFunc, request);
+        limiter->release(
+            result.IsSuccess(),
+            !result.IsSuccess()
+            && classifyError(result.GetError()) == S3ErrorClass::THROTTLING,
+            std::chrono::duration_cast<std::chrono::microseconds>(
+                std::chrono::steady_clock::now() - start),
+            bytes + responseBytes(result));
+        return result;
+    }
+
+    // GETs are hedged, see hedgedGetObject
+    template <typename RequestFunc>
+    inline Aws::S3::Model::GetObjectOutcome sendRequest(
+        std::shared_ptr<Aws::S3::S3Client> client,
+        std::shared_ptr<S3Limiter> limiter,
+        std::shared_ptr<S3Hedge> hedge,
+        RequestFunc,
+        const Aws::S3::Model::GetObjectRequest &request)
+    {
+        return hedgedGetObject(client, limiter, hedge, request);
+    }
+
+    // Run tasks on up to concurrency threads. Once a task fails no new
+    // task is started. Wait for the running tasks and re-throw the
+    // first failure.
+    static void runParallel(size_t nTasks,
+                            size_t concurrency,
+                            const std::function<void(size_t)> &task)
+    {
+        std::atomic<size_t> nextTask(0);
+        std::atomic<bool> failed(false);
+        auto worker = [&]() {
+            size_t iTask;
+            while (!failed && (iTask = nextTask++) < nTasks)
+                try {
+                    task(iTask);
+                }
+                catch (...) {
+                    failed = true;
+                    throw;
+                }
+        };
+
+        std::vector<std::future<void> > workers;
+        for (size_t i = 1; i < std::min(concurrency, nTasks); ++i)
+            workers.push_back(std::async(std::launch::async, worker));
+
+        std::exception_ptr exception;
+        try {
+            worker();
+        }
+        catch (...) {
+            exception = std::current_exception();
+        }
+        for (auto &future : workers)
+            try {
+                future.get();
+            }
+            catch (...) {
+                if (!exception)
+                    exception = std::current_exception();
+            }
+
+        if (exception)
+            std::rethrow_exception(exception);
+    }
+
     //
     // S3Init
     //
     S3Init::S3Init()
     {
         {
-             ScopedMutex lock(_lock); // LOCK
+             ScopedMutex lock(s_lock); // LOCK
 
              if (s_count == 0)
                  Aws::InitAPI(_awsOptions);
@@ -96,6 +805,115 @@ namespace scidb {
     }
 
     size_t S3Init::s_count = 0;
+    std::mutex S3Init::s_lock;
+
+    //
+    // S3ClientPool
+    //
+    S3ClientPool::Client S3ClientPool::getClient(const Config &bridgeConfig)
+    {
+        // Start from the default configuration (region from the
+        // environment or the AWS profile) and apply the settings in
+        // the bridge configuration file
+        Aws::Client::ClientConfiguration config;
+
+        config.region = bridgeConfig.getString(
+            "s3_region", config.region.c_str()).c_str();
+        config.endpointOverride = bridgeConfig.getString(
+            "s3_endpoint", config.endpointOverride.c_str()).c_str();
+        config.maxConnections = bridgeConfig.getSize(
+            "s3_max_connections", config.maxConnections, 1, CONCURRENCY_MAX);
+        config.connectTimeoutMs = bridgeConfig.getSize(
+            "s3_connect_timeout_ms", config.connectTimeoutMs, 1, LONG_MAX);
+        config.requestTimeoutMs = bridgeConfig.getSize(
+            "s3_request_timeout_ms", config.requestTimeoutMs, 1, LONG_MAX);
+        config.enableTcpKeepAlive = bridgeConfig.getBool(
+            "s3_tcp_keep_alive", config.enableTcpKeepAlive);
+        config.tcpKeepAliveIntervalMs = bridgeConfig.getSize(
+            "s3_tcp_keep_alive_interval_ms", config.tcpKeepAliveIntervalMs,
+            0, ULONG_MAX);
+        config.verifySSL = bridgeConfig.getBool(
+            "s3_verify_ssl", config.verifySSL);
+
+        auto scheme = bridgeConfig.getString("s3_scheme", "https");
+        if (scheme == "http")
+            config.scheme = Aws::Http::Scheme::HTTP;
+        else if (scheme == "https")
+            config.scheme = Aws::Http::Scheme::HTTPS;
+        else
+            throw USER_EXCEPTION(SCIDB_SE_METADATA, SCIDB_LE_ILLEGAL_OPERATION)
+                << "s3_scheme must be 'http' or 'https'";
+
+        // Retries are done by S3Driver::_retryLoop
+        config.retryStrategy =
+            Aws::MakeShared<Aws::Client::DefaultRetryStrategy>("S3Driver", 0);
+
+        // Path-style addressing is needed by most S3-compatible
+        // servers, e.g., MinIO
+        bool virtualAddressing = bridgeConfig.getBool(
+            "s3_virtual_addressing", true);
+
+        // Concurrency limit adapts between one and the maximum number
+        // of connections, unless disabled
+        bool adaptive = bridgeConfig.getBool(
+            "s3_adaptive_concurrency", true);
+        size_t initLimit = bridgeConfig.getSize(
+            "s3_initial_concurrency", LIMITER_INIT, 1, CONCURRENCY_MAX);
+
+        // GETs slower than the percentile are hedged, zero disables
+        double hedgePercentile = bridgeConfig.getDouble(
+            "s3_hedge_percentile", HEDGE_PERCENTILE);
+        double hedgeMaxOverhead = bridgeConfig.getDouble(
+            "s3_hedge_max_overhead", HEDGE_MAX_OVERHEAD);
+        if (!(hedgePercentile >= 0 && hedgePercentile < 100))
+            throw USER_EXCEPTION(SCIDB_SE_METADATA, SCIDB_LE_ILLEGAL_OPERATION)
+                << "s3_hedge_percentile must be at least 0 and less than 100";
+        if (!(hedgeMaxOverhead >= 0 && hedgeMaxOverhead <= 100))
+            throw USER_EXCEPTION(SCIDB_SE_METADATA, SCIDB_LE_ILLEGAL_OPERATION)
+                << "s3_hedge_max_overhead must be between 0 and 100";
+
+        // Clients are shared only if all their settings match
+        std::ostringstream out;
+        out << config.region
+            << "|" << config.endpointOverride
+            << "|" << scheme
+            << "|" << config.maxConnections
+            << "|" << config.connectTimeoutMs
+            << "|" << config.requestTimeoutMs
+            << "|" << config.enableTcpKeepAlive
+            << "|" << config.tcpKeepAliveIntervalMs
+            << "|" << config.verifySSL
+            << "|" << virtualAddressing
+            << "|" << adaptive
+            << "|" << initLimit
+            << "|" << hedgePercentile
+            << "|" << hedgeMaxOverhead;
+        std::string key = out.str();
+
+        {
+            ScopedMutex lock(s_lock); // LOCK
+
+            auto clientPair = s_clients.find(key);
+            if (clientPair != s_clients.end())
+                return clientPair->second;
+
+            LOG4CXX_DEBUG(logger, "S3DRIVER|client pool add:" << key);
+            Client client;
+            client.client = std::make_shared<Aws::S3::S3Client>(
+                config,
+                Aws::Client::AWSAuthV4Signer::PayloadSigningPolicy::Never,
+                virtualAddressing);
+            client.limiter = std::make_shared<S3Limiter>(
+                initLimit, config.maxConnections, adaptive);
+            client.hedge = std::make_shared<S3Hedge>(
+                hedgePercentile, hedgeMaxOverhead);
+            s_clients[key] = client;
+            return client;
+        }
+    }
+
+    std::mutex S3ClientPool::s_lock;
+    std::map<std::string, S3ClientPool::Client> S3ClientPool::s_clients;
 
     //
     // S3Driver
@@ -112,19 +930,37 @@ namespace scidb {
         _bucket = _url.substr(prefix_len, pos - prefix_len).c_str();
         _prefix = _url.substr(pos + 1);
 
-        _client = std::make_unique<Aws::S3::S3Client>();
+        auto config = Config::read();
+        auto client = S3ClientPool::getClient(*config);
+        _client = client.client;
+        _limiter = client.limiter;
+        _hedge = client.hedge;
+
+        _multipartThreshold = config->getSize(
+            "s3_multipart_threshold", MULTIPART_THRESHOLD);
+        _multipartPartSize = config->getSize(
+            "s3_multipart_part_size", MULTIPART_PART_SIZE,
+            MULTIPART_PART_MIN_SIZE, MULTIPART_PART_MAX_SIZE);
+        _multipartConcurrency = config->getSize(
+            "s3_multipart_concurrency", MULTIPART_CONCURRENCY,
+            1, CONCURRENCY_MAX);
+
+        _rangeSize = config->getSize("s3_range_size", RANGE_SIZE, 1);
+        _rangeConcurrency = config->getSize(
+            "s3_range_concurrency", RANGE_CONCURRENCY, 1, CONCURRENCY_MAX);
     }
 
     void S3Driver::init(const Query &query)
     {
         Aws::String key((_prefix + "/metadata").c_str());
 
-        Aws::S3::Model::GetObjectRequest request;
+        // Only check if metadata exists, no need to download it
+        Aws::S3::Model::HeadObjectRequest request;
         request.SetBucket(_bucket);
         request.SetKey(key);
 
-        auto outcome = _retryLoop<Aws::S3::Model::GetObjectOutcome>(
-            "Get", key, request, &Aws::S3::S3Client::GetObject, false);
+        auto outcome = _retryLoop<Aws::S3::Model::HeadObjectOutcome>(
+            "Head", key, request, &Aws::S3::S3Client::HeadObject, false);
 
         if (_mode == Driver::Mode::READ
             || _mode == Driver::Mode::UPDATE) {
@@ -145,16 +981,17 @@ namespace scidb {
                                 std::shared_ptr<arrow::Buffer> &buffer,
                                 bool reuse) const
     {
-        Aws::String key((_prefix + "/" + suffix).c_str());
+        std::shared_ptr<arrow::ResizableBuffer> target;
+        if (reuse)
+            target = std::static_pointer_cast<arrow::ResizableBuffer>(buffer);
+        else
+            THROW_NOT_OK(arrow::AllocateResizableBuffer(0, &target));
 
-        auto&& result = _getRequest(key);
-
-        auto length = result.GetContentLength();
-        _setBuffer(suffix, buffer, reuse, length);
-
-        auto& body = result.GetBody();
-        body.read(reinterpret_cast<char*>(buffer->mutable_data()), length);
+        auto length = _rangeConcurrency > 1 ?
+            _getArrowRanges(suffix, target) : _getArrow(suffix, "", target);
 
+        if (!reuse)
+            buffer = target;
         return length;
     }
 
@@ -163,14 +1000,176 @@ namespace scidb {
     {
         Aws::String key((_prefix + "/" + suffix).c_str());
 
+        if (static_cast<size_t>(buffer->size()) > _multipartThreshold) {
+            _multipartUpload(key, buffer);
+            return;
+        }
+
+        // Body reads directly from the buffer, no copy
         std::shared_ptr<Aws::IOStream> data =
-            Aws::MakeShared<Aws::StringStream>("");
-        data->write(reinterpret_cast<const char*>(buffer->data()),
-                    buffer->size());
+            Aws::MakeShared<ArrowBufferStream>("S3Driver", buffer);
 
         _putRequest(key, data);
     }
 
+    size_t S3Driver::readRange(const std::string &suffix,
+                               size_t offset,
+                               size_t length,
+                               std::shared_ptr<arrow::Buffer> &buffer) const
+    {
+        Aws::String key((_prefix + "/" + suffix).c_str());
+
+        // Reserve the requested length, the content length is smaller
+        // if the range extends past the end of the object
+        _checkSize(suffix, length);
+        std::shared_ptr<arrow::ResizableBuffer> target;
+        THROW_NOT_OK(arrow::AllocateResizableBuffer(0, &target));
+        buffer = target;
+
+        // Empty ranges can not be expressed in HTTP
+        if (length == 0)
+            return 0;
+        THROW_NOT_OK(target->Reserve(length));
+
+        // HTTP byte ranges are inclusive
+        std::ostringstream range;
+        range << "bytes=" << offset << "-" << offset + length - 1;
+        auto stream = std::make_shared<ArrowResponseTarget>(target);
+
+        Aws::S3::Model::GetObjectRequest request;
+        request.SetBucket(_bucket);
+        request.SetKey(key);
+        request.SetRange(range.str().c_str());
+        request.SetResponseStreamFactory([stream]() {
+                return Aws::New<ArrowResponseStream>("S3Driver", stream);
+            });
+
+        auto outcome = _retryLoop<Aws::S3::Model::GetObjectOutcome>(
+            "Get", key, request, &Aws::S3::S3Client::GetObject, false);
+        if (!outcome.IsSuccess()) {
+            // Ranges starting past the end of the object are not
+            // satisfiable, nothing is read, like FSDriver::readRange
+            if (outcome.GetError().GetResponseCode() ==
+                Aws::Http::HttpResponseCode::REQUESTED_RANGE_NOT_SATISFIABLE) {
+                THROW_NOT_OK(target->Resize(0, false));
+                return 0;
+            }
+            S3_EXCEPTION_NOT_SUCCESS("Get");
+        }
+        auto result = outcome.GetResultWithOwnership();
+        length = dynamic_cast<ArrowResponseStream&>(result.GetBody()).close();
+        if (length != static_cast<size_t>(result.GetContentLength())) {
+            std::ostringstream out;
+            out << "Object " << getURL() << "/" << suffix
+                << " received " << length << " bytes, expected "
+                << result.GetContentLength();
+            throw SYSTEM_EXCEPTION(SCIDB_SE_NETWORK,
+                                   SCIDB_LE_UNKNOWN_ERROR) << out.str();
+        }
+
+        return length;
+    }
+
+    size_t S3Driver::_getArrow(const std::string &suffix,
+                               const Aws::String &range,
+                               std::shared_ptr<arrow::ResizableBuffer> buffer,
+                               const Aws::String &ifMatch) const
+    {
+        Aws::String key((_prefix + "/" + suffix).c_str());
+
+        // The body is written directly into the buffer. The content
+        // length is not known when the SDK creates the response
+        // stream, so the buffer grows as the body is received. Reused
+        // buffers keep their capacity across reads.
+        auto target = std::make_shared<ArrowResponseTarget>(buffer);
+        auto&& result = _getRequest(
+            key, range, [target]() {
+                return Aws::New<ArrowResponseStream>("S3Driver", target);
+            },
+            ifMatch);
+
+        size_t length = dynamic_cast<ArrowResponseStream&>(
+            result.GetBody()).close();
+        if (length != static_cast<size_t>(result.GetContentLength())) {
+            std::ostringstream out;
+            out << "Object " << getURL() << "/" << suffix
+                << " received " << length << " bytes, expected "
+                << result.GetContentLength();
+            throw SYSTEM_EXCEPTION(SCIDB_SE_NETWORK,
+                                   SCIDB_LE_UNKNOWN_ERROR) << out.str();
+        }
+        _checkSize(suffix, length);
+
+        return length;
+    }
+
+    size_t S3Driver::_getArrowRanges(
+        const std::string &suffix,
+        std::shared_ptr<arrow::ResizableBuffer> buffer) const
+    {
+        Aws::String key((_prefix + "/" + suffix).c_str());
+
+        // First Range, its response has the object size and ETag
+        std::ostringstream range;
+        range << "bytes=0-" << _rangeSize - 1;
+        auto target = std::make_shared<ArrowResponseTarget>(buffer);
+
+        Aws::S3::Model::GetObjectRequest request;
+        request.SetBucket(_bucket);
+        request.SetKey(key);
+        request.SetRange(range.str().c_str());
+        request.SetResponseStreamFactory([target]() {
+                return Aws::New<ArrowResponseStream>("S3Driver", target);
+            });
+
+        auto outcome = _retryLoop<Aws::S3::Model::GetObjectOutcome>(
+            "Get", key, request, &Aws::S3::S3Client::GetObject, false);
+        if (!outcome.IsSuccess()) {
+            // Empty objects have no satisfiable range
+            if (outcome.GetError().GetResponseCode() ==
+                Aws::Http::HttpResponseCode::REQUESTED_RANGE_NOT_SATISFIABLE)
+                return _getArrow(suffix, "", buffer);
+            S3_EXCEPTION_NOT_SUCCESS("Get");
+        }
+        auto result = outcome.GetResultWithOwnership();
+        size_t length = dynamic_cast<ArrowResponseStream&>(
+            result.GetBody()).close();
+
+        // Content range is "bytes <first>-<last>/<size>"
+        size_t size = length;
+        const auto &contentRange = result.GetContentRange();
+        size_t pos = contentRange.rfind('/');
+        if (pos != Aws::String::npos)
+            size = std::strtoull(contentRange.c_str() + pos + 1, NULL, 10);
+        _checkSize(suffix, size);
+        if (size <= length)
+            return length;
+
+        // Remaining Ranges, written in place. Requests fail if the
+        // object changed since the first range.
+        THROW_NOT_OK(buffer->Resize(size, false));
+        const size_t nRanges = (size - length + _rangeSize - 1) / _rangeSize;
+        LOG4CXX_DEBUG(logger, "S3DRIVER|GetRanges:" << key
+                      << " size:" << size << " ranges:" << nRanges + 1);
+
+        runParallel(
+            nRanges, _rangeConcurrency, [&](size_t iRange) {
+                size_t offset = length + iRange * _rangeSize;
+                size_t rangeLength = std::min(_rangeSize, size - offset);
+
+                std::ostringstream range;
+                range << "bytes=" << offset << "-" << offset + rangeLength - 1;
+
+                _getArrow(suffix,
+                          range.str().c_str(),
+                          std::make_shared<ArrowRegionBuffer>(
+                              buffer->mutable_data() + offset, rangeLength),
+                          result.GetETag());
+            });
+
+        return size;
+    }
+
     void S3Driver::_readMetadataFile(std::shared_ptr<Metadata> metadata) const
     {
         Aws::String key((_prefix + "/metadata").c_str());
@@ -198,8 +1197,7 @@ namespace scidb {
 
         std::shared_ptr<Aws::IOStream> data =
             Aws::MakeShared<Aws::StringStream>("");
-        for (auto i = metadata->begin(); i != metadata->end(); ++i)
-            *data << i->first << "\t" << i->second << "\n";
+        *data << metadata->serialize();
 
         _putRequest(key, data);
     }
@@ -217,16 +1215,62 @@ namespace scidb {
         return outcome.GetResult().GetContents().size();
     }
 
+    std::string S3Driver::getETag() const
+    {
+        std::ostringstream out;
+
+        // Metadata ETag
+        Aws::String key((_prefix + "/metadata").c_str());
+        Aws::S3::Model::HeadObjectRequest headRequest;
+        headRequest.SetBucket(_bucket);
+        headRequest.SetKey(key);
+
+        auto headOutcome = _retryLoop<Aws::S3::Model::HeadObjectOutcome>(
+            "Head", key, headRequest, &Aws::S3::S3Client::HeadObject);
+        out << "metadata:" << headOutcome.GetResult().GetETag();
+
+        // Index Objects ETags, Listed in Key Order
+        key = (_prefix + "/index/").c_str();
+        Aws::S3::Model::ListObjectsV2Request request;
+        request.WithBucket(_bucket);
+        request.WithPrefix(key);
+
+        while (true) {
+            auto outcome = _retryLoop<Aws::S3::Model::ListObjectsV2Outcome>(
+                "List", key, request, &Aws::S3::S3Client::ListObjectsV2);
+            auto& result = outcome.GetResult();
+
+            for (auto const &object : result.GetContents())
+                out << ";" << object.GetKey() << ":" << object.GetETag();
+
+            if (!result.GetIsTruncated())
+                break;
+            request.SetContinuationToken(result.GetNextContinuationToken());
+        }
+
+        return _digestETag(out.str());
+    }
+
     const std::string& S3Driver::getURL() const
     {
         return _url;
     }
 
-    Aws::S3::Model::GetObjectResult S3Driver::_getRequest(const Aws::String &key) const
+    Aws::S3::Model::GetObjectResult S3Driver::_getRequest(
+        const Aws::String &key,
+        const Aws::String &range,
+        const Aws::IOStreamFactory &factory,
+        const Aws::String &ifMatch) const
     {
         Aws::S3::Model::GetObjectRequest request;
         request.SetBucket(_bucket);
         request.SetKey(key);
+        if (!range.empty())
+            request.SetRange(range);
+        if (factory)
+            request.SetResponseStreamFactory(factory);
+        if (!ifMatch.empty())
+            request.SetIfMatch(ifMatch);
 
         auto outcome = _retryLoop<Aws::S3::Model::GetObjectOutcome>(
             "Get", key, request, &Aws::S3::S3Client::GetObject);
@@ -234,6 +1278,7 @@ namespace scidb {
         return outcome.GetResultWithOwnership();
     }
 
+
     void S3Driver::_putRequest(const Aws::String &key,
                               std::shared_ptr<Aws::IOStream> data) const
     {
@@ -246,6 +1291,92 @@ namespace scidb {
             "Put", key, request, &Aws::S3::S3Client::PutObject);
     }
 
+    void S3Driver::_multipartUpload(const Aws::String &key,
+                                    std::shared_ptr<const arrow::Buffer> buffer) const
+    {
+        Aws::S3::Model::CreateMultipartUploadRequest createRequest;
+        createRequest.SetBucket(_bucket);
+        createRequest.SetKey(key);
+
+        auto createOutcome = _retryLoop<
+            Aws::S3::Model::CreateMultipartUploadOutcome>(
+                "CreateMultipartUpload", key, createRequest,
+                &Aws::S3::S3Client::CreateMultipartUpload);
+        auto uploadId = createOutcome.GetResult().GetUploadId();
+
+        const size_t size = buffer->size();
+        const size_t nParts = (size + _multipartPartSize - 1) / _multipartPartSize;
+        std::vector<Aws::S3::Model::CompletedPart> parts(nParts);
+        LOG4CXX_DEBUG(logger, "S3DRIVER|MultipartUpload:" << key
+                      << " size:" << size << " parts:" << nParts);
+
+        // Upload Parts, each part is retried by itself
+        std::exception_ptr exception;
+        try {
+            runParallel(
+                nParts, _multipartConcurrency, [&](size_t iPart) {
+                    size_t offset = iPart * _multipartPartSize;
+                    size_t length = std::min(_multipartPartSize, size - offset);
+
+                    Aws::S3::Model::UploadPartRequest request;
+                    request.SetBucket(_bucket);
+                    request.SetKey(key);
+                    request.SetUploadId(uploadId);
+                    request.SetPartNumber(iPart + 1); // 1-based
+                    request.SetContentLength(length);
+                    request.SetBody(Aws::MakeShared<ArrowBufferStream>(
+                                        "S3Driver",
+                                        arrow::SliceBuffer(
+                                            std::const_pointer_cast<arrow::Buffer>(
+                                                buffer),
+                                            offset,
+                                            length)));
+
+                    auto outcome = _retryLoop<Aws::S3::Model::UploadPartOutcome>(
+                        "UploadPart", key, request,
+                        &Aws::S3::S3Client::UploadPart);
+
+                    parts[iPart].SetPartNumber(iPart + 1);
+                    parts[iPart].SetETag(outcome.GetResult().GetETag());
+                });
+        }
+        catch (...) {
+            exception = std::current_exception();
+        }
+
+        if (!exception)
+            try {
+                Aws::S3::Model::CompletedMultipartUpload upload;
+                upload.SetParts(Aws::Vector<Aws::S3::Model::CompletedPart>(
+                                    parts.begin(), parts.end()));
+
+                Aws::S3::Model::CompleteMultipartUploadRequest request;
+                request.SetBucket(_bucket);
+                request.SetKey(key);
+                request.SetUploadId(uploadId);
+                request.SetMultipartUpload(upload);
+
+                _retryLoop<Aws::S3::Model::CompleteMultipartUploadOutcome>(
+                    "CompleteMultipartUpload", key, request,
+                    &Aws::S3::S3Client::CompleteMultipartUpload);
+                return;
+            }
+            catch (...) {
+                exception = std::current_exception();
+            }
+
+        // Abort Upload, otherwise S3 keeps the uploaded parts
+        Aws::S3::Model::AbortMultipartUploadRequest request;
+        request.SetBucket(_bucket);
+        request.SetKey(key);
+        request.SetUploadId(uploadId);
+        _retryLoop<Aws::S3::Model::AbortMultipartUploadOutcome>(
+            "AbortMultipartUpload", key, request,
+            &Aws::S3::S3Client::AbortMultipartUpload, false);
+
+        std::rethrow_exception(exception);
+    }
+
     // Re-try Loop Template
     template <typename Outcome, typename Request, typename RequestFunc>
     Outcome S3Driver::_retryLoop(const std::string &name,
@@ -255,24 +1386,66 @@ namespace scidb {
                                  bool throwIfFails) const
     {
         LOG4CXX_DEBUG(logger, "S3DRIVER|" << name << ":" << key);
-        auto outcome = ((*_client).*requestFunc)(request);
+
+        // Send request once an in-flight slot is available, the slot
+        // is not held while sleeping between retries
+        auto send = [&]() {
+            _limiter->acquire();
+            auto result = sendRequest(
+                _client, _limiter, _hedge, requestFunc, request);
+            s_requests++;
+            return result;
+        };
+
+        auto outcome = send();
 
         // -- - Retry - --
-        int retry = 1;
-        while (!outcome.IsSuccess() && retry < RETRY_COUNT) {
+        int attempt = 1;
+        int64_t sleep = 0;
+        while (!outcome.IsSuccess()) {
+            auto errorClass = classifyError(outcome.GetError());
+            if (errorClass == S3ErrorClass::FATAL || attempt >= RETRY_COUNT)
+                break;
+
+            int64_t base = RETRY_BASE, cost = RETRY_COST;
+            if (errorClass == S3ErrorClass::THROTTLING) {
+                base = RETRY_BASE_THROTTLE;
+                cost = RETRY_COST_THROTTLE;
+                s_throttled++;
+            }
+            if (!acquireRetryBudget(cost)) {
+                s_budgetExhausted++;
+                LOG4CXX_WARN(logger,
+                             "S3DRIVER|" << name << " s3://" << _bucket << "/"
+                             << key << " retry budget exhausted");
+                break;
+            }
+
+            sleep = decorrelatedJitter(base, sleep);
             LOG4CXX_WARN(logger,
                          "S3DRIVER|" << name << " s3://" << _bucket << "/"
-                         << key << " attempt #" << retry << " failed");
-            retry++;
-
-            std::this_thread::sleep_for(
-                std::chrono::milliseconds(RETRY_SLEEP));
+                         << key << " attempt #" << attempt << " failed ("
+                         << outcome.GetError().GetExceptionName()
+                         << "), retry in " << sleep << "ms");
+            std::this_thread::sleep_for(std::chrono::milliseconds(sleep));
 
-            outcome = ((*_client).*requestFunc)(request);
+            rewindBody(request);
+            outcome = send();
+            s_retries++;
+            attempt++;
         }
 
-        if (throwIfFails) {
-            S3_EXCEPTION_NOT_SUCCESS(name);
+        if (outcome.IsSuccess()) {
+            refundRetryBudget();
+            if (attempt > 1)
+                logMetrics(_limiter->getLimit());
+        }
+        else {
+            s_failed++;
+            logMetrics(_limiter->getLimit());
+            if (throwIfFails) {
+                S3_EXCEPTION_NOT_SUCCESS(name);
+            }
         }
         return outcome;
     }
@@ -26,16 +26,25 @@
 #ifndef S3_DRIVER_H_
 #define S3_DRIVER_H_
 
+#include "AIMDLimit.h"
 #include "Driver.h"
 
+#include <chrono>
+#include <condition_variable>
+#include <map>
 #include <mutex>
+#include <vector>
 
 #include <aws/core/Aws.h>
+#include <aws/s3/model/GetObjectRequest.h>
 #include <aws/s3/model/GetObjectResult.h>
 
 
 // Forward Declarastions to avoid including full headers - speed-up
 // compilation
+namespace scidb {
+    class Config;               // #include "Config.h"
+}
 namespace Aws {
     namespace S3 {
         class S3Client;         // #include <aws/s3/S3Client.h>
@@ -54,10 +63,111 @@ public:
 
 private:
     static size_t s_count;
+    static std::mutex s_lock;
 
     // const
     Aws::SDKOptions _awsOptions;
+};
+
+
+// Adaptive (AIMD) limit on the number of in-flight requests. The
+// limit grows additively (by one per window of successful requests)
+// while requests succeed without latency spikes and is halved on
+// throttling or when a request takes more than LIMITER_SPIKE_FACTOR
+// times the smoothed latency of requests of its size. Decreases are
+// spaced by at least one smoothed latency, so a burst of throttled
+// requests cuts the limit once. See AIMDLimit.
+class S3Limiter {
+public:
+    S3Limiter(size_t initLimit, size_t maxLimit, bool adaptive);
+
+    // Wait for an in-flight slot
+    void acquire();
+
+    // Take an in-flight slot only if one is available
+    bool tryAcquire();
+
+    // Release the slot and adjust the limit based on the request
+    // outcome, latency, and bytes transferred
+    void release(bool success,
+                 bool throttled,
+                 std::chrono::microseconds,
+                 size_t bytes);
+
+    size_t getLimit();
+
+private:
+    std::mutex _lock;
+    std::condition_variable _cond;
+
+    const bool _adaptive;
+    AIMDLimit _limit;
+    size_t _inFlight;
+};
+
+
+// Hedging of GET requests. A GET which did not complete within the
+// configured percentile of the recent latencies of GETs of its size
+// class (see AIMDLimit::getClass) is sent again and the first
+// successful response is used. GETs are classed by their range
+// length, latencies by the length received. GETs without a range
+// have no known length and are not hedged. The ratio of hedged GETs
+// is capped to bound the extra load.
+class S3Hedge {
+public:
+    // Percentile in (0, 100), zero disables hedging. Max overhead is
+    // the maximum percent of GETs which can be hedged.
+    S3Hedge(double percentile, double maxOverhead);
+
+    // Return the delay after which a new GET of up to length bytes
+    // is hedged, zero if the GET should not be hedged
+    std::chrono::microseconds getDelay(size_t length);
+
+    // Return true if a GET can be hedged within the overhead cap
+    bool acquire();
+
+    // Return the overhead taken by acquire for a GET not hedged
+    void cancel();
+
+    // Record the latency of a successful GET which received length
+    // bytes
+    void record(std::chrono::microseconds, size_t length);
+
+private:
+    struct Samples {
+        std::vector<int64_t> latencies; // Ring buffer, in microseconds
+        size_t next;
+    };
+
     std::mutex _lock;
+
+    const double _percentile;
+    const double _maxOverhead;
+    Samples _samples[LIMITER_CLASSES];
+    uint64_t _nGets;
+    uint64_t _nHedges;
+};
+
+
+// Process-wide pool of S3 clients, keyed by region, endpoint, and the
+// client settings from the bridge configuration file (see Config). S3
+// clients are thread-safe and are shared by all drivers, so the
+// credentials chain, HTTP connection pool, and TLS sessions are set
+// up once and connections are kept alive across queries. Each client
+// comes with the limiter for its in-flight requests.
+class S3ClientPool {
+public:
+    struct Client {
+        std::shared_ptr<Aws::S3::S3Client> client;
+        std::shared_ptr<S3Limiter> limiter;
+        std::shared_ptr<S3Hedge> hedge;
+    };
+
+    static Client getClient(const Config&);
+
+private:
+    static std::mutex s_lock;
+    static std::map<std::string, Client> s_clients;
 };
 
 
@@ -70,11 +180,18 @@ public:
     void writeArrow(const std::string&,
                     std::shared_ptr<const arrow::Buffer>) const;
 
+    size_t readRange(const std::string&,
+                     size_t offset,
+                     size_t length,
+                     std::shared_ptr<arrow::Buffer>&) const;
+
     void writeMetadata(std::shared_ptr<const Metadata>) const;
 
     // Count number of objects with specified prefix
     size_t count(const std::string&) const;
 
+    std::string getETag() const;
+
     // Return print-friendly path used by driver
     const std::string& getURL() const;
 
@@ -87,12 +204,42 @@ private:
     Aws::String _bucket;
     std::string _prefix;
     std::shared_ptr<Aws::S3::S3Client> _client;
+    std::shared_ptr<S3Limiter> _limiter;
+    std::shared_ptr<S3Hedge> _hedge;
+
+    // Objects larger than the threshold are uploaded in parts
+    size_t _multipartThreshold;
+    size_t _multipartPartSize;
+    size_t _multipartConcurrency;
+
+    // Objects larger than the range size are downloaded in ranges
+    size_t _rangeSize;
+    size_t _rangeConcurrency;
 
     size_t _readArrow(const std::string&, std::shared_ptr<arrow::Buffer>&, bool) const;
 
-    Aws::S3::Model::GetObjectResult _getRequest(const Aws::String&) const;
+    // Get the object, or only the specified bytes range if not empty
+    Aws::S3::Model::GetObjectResult _getRequest(
+        const Aws::String&,
+        const Aws::String &range="",
+        const Aws::IOStreamFactory &factory=Aws::IOStreamFactory(),
+        const Aws::String &ifMatch="") const;
+
+    // Get the object, or the bytes range, into the buffer
+    size_t _getArrow(const std::string &suffix,
+                     const Aws::String &range,
+                     std::shared_ptr<arrow::ResizableBuffer>,
+                     const Aws::String &ifMatch="") const;
+
+    // Get the object into the buffer using concurrent range requests
+    size_t _getArrowRanges(const std::string &suffix,
+                           std::shared_ptr<arrow::ResizableBuffer>) const;
     void _putRequest(const Aws::String&, std::shared_ptr<Aws::IOStream>) const;
 
+    // Upload parts concurrently, abort the upload if any part fails
+    void _multipartUpload(const Aws::String&,
+                          std::shared_ptr<const arrow::Buffer>) const;
+
     template <typename Outcome, typename Request, typename RequestFunc>
     Outcome _retryLoop(const std::string &name,
                        const Aws::String &key,
@@ -52,13 +52,11 @@ namespace scidb {
     // XCache
     //
     XCache::XCache(
-        std::shared_ptr<ArrowReader> arrowReader,
+        const XArray &array,
         const std::string &path,
-        const Dimensions &dims,
         size_t cacheSize):
-        _arrowReader(arrowReader),
+        _array(array),
         _path(path),
-        _dims(dims),
         _size(0),
         _sizeMax(cacheSize)
     {}
@@ -71,17 +69,13 @@ namespace scidb {
             std::shared_ptr<arrow::RecordBatch> arrowBatch;
             if (_mem.find(pos) == _mem.end()) {
                 // Download Chunk
-                auto objectName =
-                    "chunks/" + Metadata::coord2ObjectName(pos, _dims);
-                auto arrowSize = _arrowReader->readObject(objectName,
-                                                          false,
-                                                          arrowBatch);
+                auto arrowSize = _array._readChunk(pos, false, arrowBatch);
 
                 // Check if Record Batch Fits in Cache
                 if (arrowSize > _sizeMax) {
                     std::ostringstream out;
-                    out << "Size " << arrowSize << " of object "
-                        << _path << "/" << objectName
+                    out << "Size " << arrowSize << " of chunk in "
+                        << _path
                         << " for position " << pos
                         << " is bigger than cache size " << _sizeMax;
                     throw SYSTEM_EXCEPTION(SCIDB_SE_ARRAY_WRITER,
@@ -406,12 +400,9 @@ namespace scidb {
     {
         if (_array._cache != NULL)
             _arrowBatch = _array._cache->get(_firstPos);
-        else {
+        else
             // Cache is disabled
-            auto objectName =
-                "chunks/" + Metadata::coord2ObjectName(_firstPos, _dims);
-            _array._arrowReader->readObject(objectName, true, _arrowBatch);
-        }
+            _array._readChunk(_firstPos, true, _arrowBatch);
     }
 
     void XChunk::setPosition(Coordinates const& pos)
@@ -477,17 +468,23 @@ namespace scidb {
         _attrID(attrID),
         _dims(array._desc.getDimensions()),
         _chunk(array, attrID),
-        _hasCurrent(false)
+        _hasCurrent(false),
+        _restarted(false)
     {
+        if (array._fence == NULL)
+            _index = array._index;
         restart();
     }
 
     void XArrayIterator::operator ++()
     {
+        if (_index == NULL)
+            _loadIndex();
+
         if (!_hasCurrent)
             throw SYSTEM_EXCEPTION(SCIDB_SE_EXECUTION, SCIDB_LE_NO_CURRENT_ELEMENT);
 
-        if (_currIndex == _array._index->end())
+        if (_currIndex == _index->end())
             throw SYSTEM_EXCEPTION(SCIDB_SE_EXECUTION, SCIDB_LE_NO_CURRENT_ELEMENT);
 
         Query::getValidQueryPtr(_array._query);
@@ -500,7 +497,7 @@ namespace scidb {
     {
         _chunkInitialized = false;
 
-        if (_currIndex == _array._index->end())
+        if (_currIndex == _index->end())
             _hasCurrent = false;
         else {
             _hasCurrent = true;
@@ -511,9 +508,10 @@ namespace scidb {
     bool XArrayIterator::setPosition(Coordinates const& pos)
     {
         Query::getValidQueryPtr(_array._query);
+        _restarted = false;
 
         // Check that coords are inside array
-        for (size_t i = 0, n = _currPos.size(); i < n; i++)
+        for (size_t i = 0, n = _dims.size(); i < n; i++)
             if (pos[i] < _dims[i].getStartMin() || pos[i] > _dims[i].getEndMax()) {
                 _hasCurrent = false;
                 return _hasCurrent;
@@ -525,8 +523,16 @@ namespace scidb {
         _array._desc.getChunkPositionFor(chunkPos);
 
         _chunkInitialized = false;
-        _currIndex = _array._index->find(chunkPos);
-        if (_currIndex != _array._index->end())
+
+        // Fence arrays look up the fence index, without loading the
+        // index
+        if (_index == NULL) {
+            _hasCurrent = _array._contains(chunkPos);
+            return _hasCurrent;
+        }
+
+        _currIndex = _index->find(chunkPos);
+        if (_currIndex != _index->end())
             _hasCurrent = true;
         else
             _hasCurrent = false;
@@ -538,12 +544,38 @@ namespace scidb {
     {
         Query::getValidQueryPtr(_array._query);
 
-        _currIndex = _array._index->begin();
+        // Fence arrays load the index when the first chunk is used
+        if (_index == NULL) {
+            _chunkInitialized = false;
+            _restarted = true;
+            return;
+        }
+
+        _currIndex = _index->begin();
         _nextChunk();
     }
 
+    void XArrayIterator::_loadIndex()
+    {
+        _index = _array._getIndex();
+
+        if (_restarted) {
+            _restarted = false;
+            _currIndex = _index->begin();
+            _nextChunk();
+        }
+        else if (_hasCurrent) {
+            Coordinates chunkPos = _currPos;
+            _array._desc.getChunkPositionFor(chunkPos);
+            _currIndex = _index->find(chunkPos);
+        }
+    }
+
     ConstChunk const& XArrayIterator::getChunk()
     {
+        if (_restarted)
+            _loadIndex();
+
         if (!_hasCurrent)
             throw SYSTEM_EXCEPTION(SCIDB_SE_EXECUTION, SCIDB_LE_NO_CURRENT_ELEMENT);
 
@@ -560,11 +592,17 @@ namespace scidb {
 
     bool XArrayIterator::end()
     {
+        if (_restarted)
+            _loadIndex();
+
         return !_hasCurrent;
     }
 
     Coordinates const& XArrayIterator::getPosition()
     {
+        if (_restarted)
+            _loadIndex();
+
         if (!_hasCurrent)
             throw SYSTEM_EXCEPTION(SCIDB_SE_EXECUTION, SCIDB_LE_NO_CURRENT_ELEMENT);
 
@@ -578,12 +616,18 @@ namespace scidb {
                    std::shared_ptr<Query> query,
                    std::shared_ptr<const Driver> driver,
                    std::shared_ptr<const XIndex> index,
-                   const Metadata::Compression compression,
-                   const size_t cacheSize):
+                   std::shared_ptr<const Metadata> metadata,
+                   const size_t cacheSize,
+                   std::shared_ptr<XIndexFence> fence):
         _desc(desc),
         _query(query),
         _driver(driver),
-        _index(index)
+        _packed(metadata->getPackSize() > 0),
+        _index(index),
+        _fence(fence),
+        _chunkFanout(metadata->getChunkFanout()),
+        _packID(-1),
+        _packOffset(0)
     {
         auto nInst = _query->getInstancesCount();
         SCIDB_ASSERT(nInst > 0 && _query->getInstanceID() < nInst);
@@ -591,17 +635,119 @@ namespace scidb {
         // Prepare Reader
         _arrowReader = std::make_shared<ArrowReader>(desc.getAttributes(true),
                                                      desc.getDimensions(),
-                                                     compression,
-                                                     _driver);
+                                                     metadata->getCompression(),
+                                                     _driver,
+                                                     metadata->getCompressionLayout(),
+                                                     metadata->getCompressionFilter());
+        if (metadata->getCompression() == Metadata::Compression::AUTO)
+            _arrowReader->setColumnCompression(metadata->getColumnCompression());
 
         // If Cache Size Is 0, The Cache Will Be disabled
         if (cacheSize > 0)
-            _cache = std::make_unique<XCache>(_arrowReader,
+            _cache = std::make_unique<XCache>(*this,
                                                _driver->getURL(),
-                                               _desc.getDimensions(),
                                                cacheSize);
     }
 
+    bool XArray::_contains(const Coordinates &chunkPos) const
+    {
+        // Chunks are iterated by their primary instance only
+        if (_desc.getPrimaryInstanceId(chunkPos, _query->getInstancesCount())
+            != _query->getInstanceID())
+            return false;
+
+        ScopedMutex lock(_indexLock); // LOCK
+        if (_index != NULL)
+            return _index->find(chunkPos) != _index->end();
+        return _fence->contains(chunkPos);
+    }
+
+    std::shared_ptr<const XIndex> XArray::_getIndex() const
+    {
+        ScopedMutex lock(_indexLock); // LOCK
+        if (_index == NULL) {
+            auto index = std::make_shared<XIndex>(_desc);
+            index->loadFence(_query, *_fence);
+            _index = index;
+        }
+        return _index;
+    }
+
+    size_t XArray::_readChunk(const Coordinates &pos,
+                              bool reuse,
+                              std::shared_ptr<arrow::RecordBatch> &arrowBatch) const
+    {
+        if (!_packed)
+            return _arrowReader->readObject(
+                Metadata::chunkObjectName(pos, _desc.getDimensions(), _chunkFanout),
+                reuse,
+                arrowBatch);
+
+        auto location = _index->getLocation(pos);
+        if (location == NULL) {
+            std::ostringstream out;
+            out << "Location of chunk " << pos << " not found in index of "
+                << _driver->getURL();
+            throw SYSTEM_EXCEPTION(SCIDB_SE_ARRAY_WRITER,
+                                   SCIDB_LE_UNKNOWN_ERROR) << out.str();
+        }
+        auto objectName = Metadata::packObjectName(location->pack, _chunkFanout);
+
+        std::shared_ptr<arrow::Buffer> arrowBuffer;
+        {
+            ScopedMutex lock(_packLock); // LOCK
+
+            // Read Range If Chunk Is Not In Last Range
+            if (_packID != location->pack
+                || location->offset < _packOffset
+                || (location->offset + location->length
+                    > _packOffset + _packBuffer->size())) {
+
+                // Extend Range Over Next Chunks In the Same Pack
+                int64_t end = location->offset + location->length;
+                auto posPtr = _index->find(pos);
+                if (posPtr != _index->end())
+                    ++posPtr;
+                for (; posPtr != _index->end(); ++posPtr) {
+                    auto next = _index->getLocation(*posPtr);
+                    if (next->pack != location->pack
+                        || next->offset < end
+                        || next->offset - end > PACK_GAP_MAX
+                        || next->offset + next->length - location->offset > PACK_RANGE_MAX)
+                        break;
+                    end = next->offset + next->length;
+                }
+
+                _packID = -1;
+                auto size = _driver->readRange(objectName,
+                                               location->offset,
+                                               end - location->offset,
+                                               _packBuffer);
+                if (size < static_cast<size_t>(location->length)) {
+                    std::ostringstream out;
+                    out << "Chunk " << pos << " at offset " << location->offset
+                        << " and length " << location->length
+                        << " is past the end of " << _driver->getURL()
+                        << "/" << objectName;
+                    throw SYSTEM_EXCEPTION(SCIDB_SE_ARRAY_WRITER,
+                                           SCIDB_LE_UNKNOWN_ERROR) << out.str();
+                }
+                _packID = location->pack;
+                _packOffset = location->offset;
+                LOG4CXX_DEBUG(logger, "XARRAY|readChunk pack:" << objectName
+                              << " offset:" << _packOffset
+                              << " size:" << size);
+            }
+
+            arrowBuffer = arrow::SliceBuffer(_packBuffer,
+                                             location->offset - _packOffset,
+                                             location->length);
+        }
+
+        _arrowReader->readBuffer(objectName, arrowBuffer, arrowBatch);
+        return location->length;
+    }
+
     ArrayDesc const& XArray::getArrayDesc() const {
         return _desc;
     }
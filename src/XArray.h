@@ -45,6 +45,8 @@ namespace scidb {
 
 namespace scidb {
 
+class XArray;
+
 typedef struct {
     std::list<Coordinates>::iterator lruIt;
     std::shared_ptr<arrow::RecordBatch> arrowBatch;
@@ -53,17 +55,15 @@ typedef struct {
 
 class XCache {
 public:
-    XCache(std::shared_ptr<ArrowReader>,
+    XCache(const XArray&,
            const std::string &path,
-           const Dimensions&,
            size_t);
 
     std::shared_ptr<arrow::RecordBatch> get(Coordinates);
 
 private:
-    const std::shared_ptr<ArrowReader> _arrowReader;
+    const XArray& _array;
     const std::string _path;
-    const Dimensions _dims;
     size_t _size;
     const size_t _sizeMax;
     std::list<Coordinates> _lru;
@@ -71,7 +71,6 @@ private:
     std::mutex _lock;
 };
 
-class XArray;
 class XArrayIterator;
 class XChunk;
 
@@ -171,6 +170,10 @@ public:
 private:
     void _nextChunk();
 
+    // Get the index of the array, if not yet loaded, and look up the
+    // position set by restart or setPosition in it
+    void _loadIndex();
+
     const XArray& _array;
     const AttributeID _attrID;
     const Dimensions _dims;
@@ -179,6 +182,12 @@ private:
     Coordinates _currPos;
     bool _hasCurrent;
     bool _chunkInitialized;
+
+    // NULL until chunks are iterated, for fence arrays. Until then,
+    // _currIndex is not set and _restarted is set if the position is
+    // the first chunk.
+    std::shared_ptr<const XIndex> _index;
+    bool _restarted;
     XIndexStore::const_iterator _currIndex;
 };
 
@@ -187,14 +196,16 @@ class XArray : public Array
     friend class XArrayIterator;
     friend class XChunkIterator;
     friend class XChunk;
+    friend class XCache;
 
 public:
     XArray(const ArrayDesc&,
            std::shared_ptr<Query>,
            std::shared_ptr<const Driver>,
            std::shared_ptr<const XIndex>,
-           const Metadata::Compression compression,
-           const size_t cacheSize);
+           std::shared_ptr<const Metadata>,
+           const size_t cacheSize,
+           std::shared_ptr<XIndexFence> fence=NULL);
 
     virtual ArrayDesc const& getArrayDesc() const;
 
@@ -210,9 +221,41 @@ private:
 
     // XBridge members
     std::shared_ptr<const Driver> _driver;
-    std::shared_ptr<const XIndex> _index;
+    const bool _packed;
+
+    // For fence arrays, the index is NULL and positions are looked
+    // up in the fence index. The index is loaded when chunks are
+    // first iterated.
+    mutable std::mutex _indexLock;
+    mutable std::shared_ptr<const XIndex> _index;
+    std::shared_ptr<XIndexFence> _fence;
+
     std::shared_ptr<ArrowReader> _arrowReader; // Array Reader
+    size_t _chunkFanout;
     std::unique_ptr<XCache> _cache;
+
+    // Last range read from a pack object, chunks of packed arrays
+    // are sliced from it
+    mutable std::mutex _packLock;
+    mutable int64_t _packID;
+    mutable int64_t _packOffset;
+    mutable std::shared_ptr<arrow::Buffer> _packBuffer;
+
+    // Check if the chunk is stored and belongs to the current
+    // instance, using the fence index if the index is not loaded
+    bool _contains(const Coordinates &chunkPos) const;
+
+    // Get the index, loading it from the fence index if needed
+    std::shared_ptr<const XIndex> _getIndex() const;
+
+    // Read the chunk object, or its range of the pack object. For
+    // packed arrays, the range read extends over the following
+    // chunks of the index in the same pack, up to PACK_RANGE_MAX
+    // bytes, skipping gaps of at most PACK_GAP_MAX bytes. Returns
+    // the size of the chunk object.
+    size_t _readChunk(const Coordinates&,
+                      bool reuse,
+                      std::shared_ptr<arrow::RecordBatch>&) const;
 };
 
 } // namespace scidb
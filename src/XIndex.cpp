@@ -25,6 +25,11 @@
 
 #include "XIndex.h"
 
+#include <cstring>
+#include <limits>
+#include <mutex>
+#include <numeric>
+
 // SciDB
 #include <array/MemoryBuffer.h>
 #include <network/Network.h>
@@ -33,10 +38,12 @@
 #include <system/UserException.h>
 
 // Arrow
+#include <arrow/array.h>
 #include <arrow/builder.h>
 #include <arrow/io/compressed.h>
 #include <arrow/io/memory.h>
 #include <arrow/ipc/reader.h>
+#include <arrow/record_batch.h>
 #include <arrow/util/compression.h>
 
 
@@ -52,6 +59,175 @@ namespace scidb {
 
 static log4cxx::LoggerPtr logger(log4cxx::Logger::getLogger("scidb.xindex"));
 
+//
+// Arrow Column Batch
+//
+// Record batch of an object in column layout (see ARROW_COLUMN_MAGIC
+// in XIndex.h). Columns are decompressed when first used, so chunk
+// iterators only pay for the attributes they read. Operations other
+// than column access work on a fully decompressed copy.
+//
+class ArrowColumnBatch : public arrow::RecordBatch {
+public:
+    ArrowColumnBatch(const std::shared_ptr<arrow::Schema> &schema,
+                     int64_t nRows,
+                     std::shared_ptr<arrow::Buffer> buffer,
+                     std::vector<int64_t> &&offsets,
+                     std::vector<int64_t> &&nullCounts,
+                     const std::vector<Metadata::Compression> &compression,
+                     Metadata::CompressionFilter filter,
+                     const std::string &path):
+        arrow::RecordBatch(schema, nRows),
+        _buffer(buffer),
+        _offsets(std::move(offsets)),
+        _nullCounts(std::move(nullCounts)),
+        _compression(compression),
+        _filter(filter),
+        _path(path),
+        _codecs(schema->num_fields()),
+        _columns(schema->num_fields())
+    {}
+
+    std::shared_ptr<arrow::Array> column(int i) const override {
+        std::lock_guard<std::mutex> lock(_lock);
+        if (_columns[i] == NULL)
+            _columns[i] = _decode(i);
+        return _columns[i];
+    }
+
+    std::shared_ptr<arrow::ArrayData> column_data(int i) const override {
+        return column(i)->data();
+    }
+
+    using arrow::RecordBatch::AddColumn;
+    arrow::Status AddColumn(int i,
+                            const std::shared_ptr<arrow::Field> &field,
+                            const std::shared_ptr<arrow::Array> &column,
+                            std::shared_ptr<arrow::RecordBatch> *out) const override {
+        return _decodeAll()->AddColumn(i, field, column, out);
+    }
+
+    arrow::Status RemoveColumn(int i,
+                               std::shared_ptr<arrow::RecordBatch> *out) const override {
+        return _decodeAll()->RemoveColumn(i, out);
+    }
+
+    std::shared_ptr<arrow::RecordBatch> ReplaceSchemaMetadata(
+        const std::shared_ptr<const arrow::KeyValueMetadata> &metadata) const override {
+        return _decodeAll()->ReplaceSchemaMetadata(metadata);
+    }
+
+    using arrow::RecordBatch::Slice;
+    std::shared_ptr<arrow::RecordBatch> Slice(int64_t offset,
+                                              int64_t length) const override {
+        return _decodeAll()->Slice(offset, length);
+    }
+
+private:
+    const std::shared_ptr<arrow::Buffer> _buffer;
+    const std::vector<int64_t> _offsets;
+    const std::vector<int64_t> _nullCounts;
+    const std::vector<Metadata::Compression> _compression; // Per column
+    const Metadata::CompressionFilter _filter;
+    const std::string _path;
+
+    mutable std::mutex _lock;
+    mutable std::vector<std::unique_ptr<arrow::util::Codec> > _codecs;
+    mutable std::shared_ptr<arrow::ResizableBuffer> _filterBuffer;
+    mutable std::vector<std::shared_ptr<arrow::Array> > _columns;
+
+    int64_t _readInt64(int64_t &pos, int64_t end) const {
+        if (pos + static_cast<int64_t>(sizeof(int64_t)) > end)
+            _fail("is truncated");
+        int64_t value;
+        std::memcpy(&value, _buffer->data() + pos, sizeof(value));
+        pos += sizeof(value);
+        return value;
+    }
+
+    void _fail(const std::string &reason) const {
+        std::ostringstream out;
+        out << "Column object " << _path << " " << reason;
+        throw SYSTEM_EXCEPTION(SCIDB_SE_ARRAY_WRITER,
+                               SCIDB_LE_UNKNOWN_ERROR) << out.str();
+    }
+
+    // Requires lock
+    std::shared_ptr<arrow::Array> _decode(int i) const {
+        int64_t pos = _offsets[i];
+        const int64_t end = _offsets[i + 1];
+
+        const int64_t nBuffers = _readInt64(pos, end);
+        if (nBuffers < 0 || nBuffers > 3)
+            _fail("has an invalid number of buffers");
+        const auto &type = *schema_->field(i)->type();
+        std::vector<std::shared_ptr<arrow::Buffer> > buffers(nBuffers);
+        for (int64_t j = 0; j < nBuffers; ++j) {
+            auto &buffer = buffers[j];
+            const int64_t rawLength = _readInt64(pos, end);
+            const int64_t storedLength = _readInt64(pos, end);
+            if (rawLength < 0)
+                continue;
+            if (storedLength < 0 || pos + storedLength > end)
+                _fail("is truncated");
+
+            if (storedLength == rawLength)
+                // Stored As Is, No Copy
+                buffer = arrow::SliceBuffer(_buffer, pos, rawLength);
+            else {
+                auto &codec = _codecs[i];
+                if (codec == NULL)
+                    codec = ArrowReader::makeCodec(_compression[i]);
+                if (codec == NULL)
+                    _fail("has a compressed buffer but no compression");
+                THROW_NOT_OK(arrow::AllocateBuffer(rawLength, &buffer));
+
+                // Decompress Shuffled Buffers Aside, Then Unshuffle
+                const int width = ArrowReader::filterWidth(_filter, type, j);
+                if (width > 0) {
+                    if (_filterBuffer == NULL)
+                        THROW_NOT_OK(arrow::AllocateResizableBuffer(
+                                         rawLength, &_filterBuffer));
+                    else
+                        THROW_NOT_OK(_filterBuffer->Resize(rawLength, false));
+                }
+                uint8_t *out = width > 0 ?
+                    _filterBuffer->mutable_data() : buffer->mutable_data();
+
+                int64_t length;
+                ASSIGN_OR_THROW(length,
+                                codec->Decompress(
+                                    storedLength,
+                                    _buffer->data() + pos,
+                                    rawLength,
+                                    out));
+                if (length != rawLength)
+                    _fail("has a buffer of the wrong size");
+                if (width > 0)
+                    ArrowReader::unshuffle(_filter,
+                                           width,
+                                           out,
+                                           rawLength,
+                                           buffer->mutable_data());
+            }
+            pos += (storedLength + 7) / 8 * 8;
+        }
+
+        return arrow::MakeArray(
+            arrow::ArrayData::Make(schema_->field(i)->type(),
+                                   num_rows_,
+                                   std::move(buffers),
+                                   _nullCounts[i]));
+    }
+
+    std::shared_ptr<arrow::RecordBatch> _decodeAll() const {
+        std::vector<std::shared_ptr<arrow::Array> > columns;
+        for (int i = 0; i < num_columns(); ++i)
+            columns.push_back(column(i));
+        return arrow::RecordBatch::Make(schema_, num_rows_, columns);
+    }
+};
+
 //
 // Arrow Reader
 //
@@ -59,16 +235,177 @@ ArrowReader::ArrowReader(
     const Attributes &attributes,
     const Dimensions &dimensions,
     const Metadata::Compression compression,
-    std::shared_ptr<const Driver> driver):
+    std::shared_ptr<const Driver> driver,
+    const Metadata::CompressionLayout layout,
+    const Metadata::CompressionFilter filter):
     _schema(scidb2ArrowSchema(attributes, dimensions)),
     _compression(compression),
+    _layout(layout),
+    _filter(filter),
+    _columnCompression(_schema->num_fields(), compression),
     _driver(driver)
 {
     THROW_NOT_OK(arrow::AllocateResizableBuffer(0, &_arrowResizableBuffer));
 
-    if (_compression == Metadata::Compression::GZIP)
-        _arrowCodec = *arrow::util::Codec::Create(
-            arrow::Compression::type::GZIP);
+    // Column Batches Have Their Own Codecs
+    if (_layout == Metadata::CompressionLayout::LAYOUT_STREAM)
+        _arrowCodec = makeCodec(_compression);
+}
+
+void ArrowReader::setColumnCompression(
+    const std::vector<Metadata::ColumnCompression> &columnCompression)
+{
+    if (columnCompression.size() != _columnCompression.size()) {
+        std::ostringstream error;
+        error << "Number of column codecs " << columnCompression.size()
+              << " does not match the number of columns "
+              << _columnCompression.size();
+        throw SYSTEM_EXCEPTION(SCIDB_SE_METADATA, SCIDB_LE_ILLEGAL_OPERATION)
+            << error.str();
+    }
+    for (size_t i = 0; i < columnCompression.size(); ++i)
+        _columnCompression[i] = columnCompression[i].compression;
+}
+
+std::unique_ptr<arrow::util::Codec> ArrowReader::makeCodec(
+    Metadata::Compression compression,
+    int level)
+{
+    arrow::Compression::type type;
+    switch (compression) {
+    case Metadata::Compression::NONE:
+        return NULL;
+    case Metadata::Compression::GZIP:
+        type = arrow::Compression::type::GZIP;
+        break;
+    case Metadata::Compression::ZSTD:
+        type = arrow::Compression::type::ZSTD;
+        break;
+    case Metadata::Compression::LZ4:
+        // In Arrow 0.16, streams use the LZ4 frame format, while the
+        // one-shot Compress and Decompress of the column layout (and
+        // pyarrow.compress) use raw LZ4 blocks
+        type = arrow::Compression::type::LZ4;
+        break;
+    case Metadata::Compression::SNAPPY:
+        type = arrow::Compression::type::SNAPPY;
+        break;
+    default: {
+        std::ostringstream error;
+        error << "Unsupported compression '" << compression << "'";
+        throw SYSTEM_EXCEPTION(SCIDB_SE_INTERNAL, SCIDB_LE_ILLEGAL_OPERATION)
+            << error.str();
+    }
+    }
+
+    std::unique_ptr<arrow::util::Codec> codec;
+    ASSIGN_OR_THROW(codec, arrow::util::Codec::Create(type, level));
+    return codec;
+}
+
+bool ArrowReader::isBlockCompression(Metadata::Compression compression)
+{
+    return compression == Metadata::Compression::SNAPPY;
+}
+
+int ArrowReader::filterWidth(Metadata::CompressionFilter filter,
+                             const arrow::DataType &type,
+                             size_t iBuffer)
+{
+    // Only the Value Buffer (After the Validity Bitmap) of Fixed-Width
+    // Types of Two Bytes or More
+    if (filter == Metadata::CompressionFilter::FILTER_NONE || iBuffer != 1)
+        return 0;
+    auto fixedType = dynamic_cast<const arrow::FixedWidthType*>(&type);
+    if (fixedType == NULL
+        || fixedType->bit_width() < 16
+        || fixedType->bit_width() % 8 != 0)
+        return 0;
+    return fixedType->bit_width() / 8;
+}
+
+// Transpose the 8x8 bit matrix, bit 8 * r + c to bit 8 * c + r (see
+// Hacker's Delight, 7-3). Its own inverse.
+static inline uint64_t transposeBits(uint64_t x)
+{
+    uint64_t t;
+    t = (x ^ (x >> 7)) & 0x00AA00AA00AA00AAULL;
+    x = x ^ t ^ (t << 7);
+    t = (x ^ (x >> 14)) & 0x0000CCCC0000CCCCULL;
+    x = x ^ t ^ (t << 14);
+    t = (x ^ (x >> 28)) & 0x00000000F0F0F0F0ULL;
+    x = x ^ t ^ (t << 28);
+    return x;
+}
+
+void ArrowReader::shuffle(Metadata::CompressionFilter filter,
+                          int width,
+                          const uint8_t *in,
+                          int64_t length,
+                          uint8_t *out)
+{
+    const int64_t n = length / width;
+    int64_t nShuffled;
+
+    if (filter == Metadata::CompressionFilter::FILTER_SHUFFLE) {
+        nShuffled = n;
+        for (int b = 0; b < width; ++b)
+            for (int64_t i = 0; i < n; ++i)
+                out[b * n + i] = in[i * width + b];
+    }
+    else {
+        // Groups of 8 Elements, Row r Holds Bit r % 8 of Byte r / 8
+        nShuffled = n - n % 8;
+        const int64_t rowLength = nShuffled / 8;
+        for (int64_t i = 0; i < nShuffled; i += 8)
+            for (int b = 0; b < width; ++b) {
+                uint64_t x = 0;
+                for (int e = 0; e < 8; ++e)
+                    x |= static_cast<uint64_t>(in[(i + e) * width + b]) << (8 * e);
+                x = transposeBits(x);
+                for (int k = 0; k < 8; ++k)
+                    out[(8 * b + k) * rowLength + i / 8] = x >> (8 * k);
+            }
+    }
+
+    std::memcpy(out + nShuffled * width,
+                in + nShuffled * width,
+                length - nShuffled * width);
+}
+
+void ArrowReader::unshuffle(Metadata::CompressionFilter filter,
+                            int width,
+                            const uint8_t *in,
+                            int64_t length,
+                            uint8_t *out)
+{
+    const int64_t n = length / width;
+    int64_t nShuffled;
+
+    if (filter == Metadata::CompressionFilter::FILTER_SHUFFLE) {
+        nShuffled = n;
+        for (int64_t i = 0; i < n; ++i)
+            for (int b = 0; b < width; ++b)
+                out[i * width + b] = in[b * n + i];
+    }
+    else {
+        nShuffled = n - n % 8;
+        const int64_t rowLength = nShuffled / 8;
+        for (int64_t i = 0; i < nShuffled; i += 8)
+            for (int b = 0; b < width; ++b) {
+                uint64_t x = 0;
+                for (int k = 0; k < 8; ++k)
+                    x |= static_cast<uint64_t>(
+                        in[(8 * b + k) * rowLength + i / 8]) << (8 * k);
+                x = transposeBits(x);
+                for (int e = 0; e < 8; ++e)
+                    out[(i + e) * width + b] = x >> (8 * e);
+            }
+    }
+
+    std::memcpy(out + nShuffled * width,
+                in + nShuffled * width,
+                length - nShuffled * width);
 }
 
 size_t ArrowReader::readObject(
@@ -78,24 +415,64 @@ size_t ArrowReader::readObject(
 {
     // Download Chunk
     size_t arrowSize;
-    if (reuse) {
+    std::shared_ptr<arrow::Buffer> arrowBuffer;
+    // Column Batches Keep the Object Buffer, It Cannot Be Reused
+    if (reuse
+        && !_driver->isZeroCopy()
+        && _layout == Metadata::CompressionLayout::LAYOUT_STREAM) {
         // Reuse an Arrow ResizableBuffer
         arrowSize = _driver->readArrow(name, _arrowResizableBuffer);
-
-        _arrowBufferReader = std::make_shared<arrow::io::BufferReader>(
-            _arrowResizableBuffer);
+        arrowBuffer = _arrowResizableBuffer;
     }
-    else {
+    else
         // Get a new Arrow Buffer
-        std::shared_ptr<arrow::Buffer> arrowBuffer;
         arrowSize = _driver->readArrow(name, arrowBuffer);
 
-        _arrowBufferReader = std::make_shared<arrow::io::BufferReader>(
-            arrowBuffer);
+    readBuffer(name, arrowBuffer, arrowBatch);
+    return arrowSize;
+}
+
+void ArrowReader::readBuffer(
+    const std::string &name,
+    std::shared_ptr<arrow::Buffer> arrowBuffer,
+    std::shared_ptr<arrow::RecordBatch> &arrowBatch)
+{
+    if (_layout == Metadata::CompressionLayout::LAYOUT_COLUMN) {
+        _readColumns(name, arrowBuffer, arrowBatch);
+        return;
     }
 
+    // Decompress Block, If Enabled
+    if (isBlockCompression(_compression)) {
+        int64_t length;
+        if (arrowBuffer->size() < static_cast<int64_t>(sizeof(length))) {
+            std::ostringstream out;
+            out << "Compressed object " << _driver->getURL() << "/" << name
+                << " is too short";
+            throw SYSTEM_EXCEPTION(SCIDB_SE_ARRAY_WRITER,
+                                   SCIDB_LE_UNKNOWN_ERROR) << out.str();
+        }
+        std::memcpy(&length, arrowBuffer->data(), sizeof(length));
+
+        // A new buffer each time, record batches point into it
+        std::shared_ptr<arrow::Buffer> blockBuffer;
+        THROW_NOT_OK(arrow::AllocateBuffer(length, &blockBuffer));
+        int64_t blockLength;
+        ASSIGN_OR_THROW(blockLength,
+                        _arrowCodec->Decompress(
+                            arrowBuffer->size() - sizeof(length),
+                            arrowBuffer->data() + sizeof(length),
+                            length,
+                            blockBuffer->mutable_data()));
+        arrowBuffer = arrow::SliceBuffer(blockBuffer, 0, blockLength);
+    }
+
+    _arrowBufferReader = std::make_shared<arrow::io::BufferReader>(
+        arrowBuffer);
+
     // Setup Arrow Compression, If Enabled
-    if (_compression != Metadata::Compression::NONE) {
+    if (_compression != Metadata::Compression::NONE
+        && !isBlockCompression(_compression)) {
         ASSIGN_OR_THROW(_arrowCompressedStream,
                         arrow::io::CompressedInputStream::Make(
                             _arrowCodec.get(), _arrowBufferReader));
@@ -133,7 +510,54 @@ size_t ArrowReader::readObject(
                                SCIDB_LE_UNKNOWN_ERROR) << out.str();
     }
 
-    return arrowSize;
+}
+
+void ArrowReader::_readColumns(
+    const std::string &name,
+    std::shared_ptr<arrow::Buffer> arrowBuffer,
+    std::shared_ptr<arrow::RecordBatch> &arrowBatch)
+{
+    const int64_t size = arrowBuffer->size();
+    const int64_t nColumns = _schema->num_fields();
+    const int64_t footerSize = (2 * nColumns + 3) * sizeof(int64_t)
+        + sizeof(ARROW_COLUMN_MAGIC) - 1;
+
+    // Read Footer
+    std::vector<int64_t> footer(2 * nColumns + 3);
+    bool valid = size >= footerSize
+        && std::memcmp(arrowBuffer->data() + size - sizeof(ARROW_COLUMN_MAGIC) + 1,
+                       ARROW_COLUMN_MAGIC,
+                       sizeof(ARROW_COLUMN_MAGIC) - 1) == 0;
+    if (valid) {
+        std::memcpy(footer.data(),
+                    arrowBuffer->data() + size - footerSize,
+                    footer.size() * sizeof(int64_t));
+        valid = footer[2 * nColumns + 2] == nColumns
+            && footer[2 * nColumns + 1] >= 0
+            && footer[0] == 0
+            && footer[nColumns] <= size - footerSize;
+        for (int64_t i = 0; valid && i < nColumns; ++i)
+            valid = footer[i] <= footer[i + 1];
+    }
+    if (!valid) {
+        std::ostringstream out;
+        out << "Footer of " << _driver->getURL() << "/" << name
+            << " does not match the column layout of the expected schema ("
+            << _schema->ToString() << ")";
+        throw SYSTEM_EXCEPTION(SCIDB_SE_ARRAY_WRITER,
+                               SCIDB_LE_UNKNOWN_ERROR) << out.str();
+    }
+
+    arrowBatch = std::make_shared<ArrowColumnBatch>(
+        _schema,
+        footer[2 * nColumns + 1],
+        arrowBuffer,
+        std::vector<int64_t>(footer.begin(), footer.begin() + nColumns + 1),
+        std::vector<int64_t>(footer.begin() + nColumns + 1,
+                             footer.begin() + 2 * nColumns + 1),
+        _columnCompression,
+        _filter,
+        _driver->getURL() + "/" + name);
 }
 
 std::shared_ptr<arrow::Schema> ArrowReader::scidb2ArrowSchema(
@@ -231,109 +655,302 @@ std::shared_ptr<arrow::Schema> ArrowReader::scidb2ArrowSchema(
 
 
 
+//
+// Coordinates Encoder
+//
+// Coordinates exchanged between instances are encoded as the
+// difference from the previous coordinates, Zig-Zag encoded and
+// stored as variable length integers (7 bits per byte). Sorted chunk
+// coordinates differ by a few chunk intervals, so most values take
+// one or two bytes instead of eight. The encoded buffer starts with
+// the number of coordinates. An empty index is encoded as a one byte
+// buffer, matching the "empty" buffer sent by BufSend callers.
+//
+class CoordinatesEncoder {
+public:
+    CoordinatesEncoder(size_t nDims):
+        _nDims(nDims),
+        _count(0),
+        _prev(nDims, 0)
+    {}
+
+    inline void append(const Coordinate *pos) {
+        for (size_t i = 0; i < _nDims; ++i) {
+            uint64_t delta = static_cast<uint64_t>(pos[i]) -
+                static_cast<uint64_t>(_prev[i]);
+            uint64_t value = (delta << 1) ^ static_cast<uint64_t>(
+                static_cast<int64_t>(delta) >> 63);
+            _prev[i] = pos[i];
+
+            while (value >= 0x80) {
+                _data.push_back(static_cast<uint8_t>(value | 0x80));
+                value >>= 7;
+            }
+            _data.push_back(static_cast<uint8_t>(value));
+        }
+        _count++;
+    }
+
+    std::shared_ptr<SharedBuffer> finalize() const {
+        uint8_t header[10];
+        size_t headerSize = 0;
+        for (uint64_t value = _count; ; value >>= 7) {
+            if (value < 0x80) {
+                header[headerSize++] = static_cast<uint8_t>(value);
+                break;
+            }
+            header[headerSize++] = static_cast<uint8_t>(value | 0x80);
+        }
+
+        // MemoryBuffer will alocate the output buffer, memcopy is
+        // skipped because of the NULL
+        std::shared_ptr<SharedBuffer> buf(
+            new MemoryBuffer(NULL, headerSize + _data.size()));
+        uint8_t *mem = static_cast<uint8_t*>(buf->getWriteData());
+        std::copy(header, header + headerSize, mem);
+        std::copy(_data.begin(), _data.end(), mem + headerSize);
+        return buf;
+    }
+
+private:
+    const size_t _nDims;
+    size_t _count;
+    std::vector<Coordinate> _prev;
+    std::vector<uint8_t> _data;
+};
+
+inline const uint8_t* decodeVarint(const uint8_t *ptr,
+                                   const uint8_t *end,
+                                   uint64_t &value) {
+    // Fast Path for One and Two Byte Values
+    if (end - ptr >= 2) {
+        if (ptr[0] < 0x80) {
+            value = ptr[0];
+            return ptr + 1;
+        }
+        if (ptr[1] < 0x80) {
+            value = (ptr[0] & 0x7f) | (static_cast<uint64_t>(ptr[1]) << 7);
+            return ptr + 2;
+        }
+    }
+    value = 0;
+    for (unsigned shift = 0; shift < 64 && ptr < end; shift += 7) {
+        uint8_t byte = *ptr++;
+        value |= static_cast<uint64_t>(byte & 0x7f) << shift;
+        if (byte < 0x80)
+            return ptr;
+    }
+    throw SYSTEM_EXCEPTION(SCIDB_SE_NETWORK, SCIDB_LE_UNKNOWN_ERROR)
+        << "Invalid encoded index buffer";
+}
+
 //
 // XIndex
 //
-XIndex::XIndex(const ArrayDesc &desc):
+static std::string indexObjectName(size_t iIndex) {
+    std::ostringstream out;
+    out << "index/" << iIndex;
+    return out.str();
+}
+
+XIndex::XIndex(const ArrayDesc &desc, bool packed):
     _desc(desc),
-    _dims(desc.getDimensions()),
-    _nDims(_dims.size())
+    _dims(_desc.getDimensions()),
+    _nDims(_dims.size()),
+    _packed(packed),
+    _width(_nDims + (packed ? XINDEX_LOCATION_SIZE : 0))
 {}
 
+Dimensions XIndex::getIndexDimensions(const Dimensions &dims, bool packed) {
+    Dimensions indexDims(dims);
+    if (packed)
+        for (auto name : {"chunk_pack", "chunk_offset", "chunk_length"})
+            indexDims.push_back(
+                DimensionDesc(name, 0, CoordinateBounds::getMax(), 1, 0));
+    return indexDims;
+}
+
 size_t XIndex::size() const {
     return _values.size();
 }
 
+size_t XIndex::memorySize() const {
+    const size_t coordsSize = _nDims * sizeof(Coordinate);
+    size_t size = _values.capacity() * sizeof(Coordinates)
+        + _values.size() * coordsSize;
+
+    // Each location node holds a copy of the coordinates, the next
+    // node pointer, and the cached hash
+    typedef decltype(_locations)::value_type Location;
+    size += _locations.bucket_count() * sizeof(void*)
+        + _locations.size() * (sizeof(Location) + sizeof(void*)
+                               + sizeof(size_t) + coordsSize);
+    return size;
+}
+
 void XIndex::insert(const Coordinates &pos) {
     _values.push_back(pos);
     // _values.insert(pos);
 }
 
+void XIndex::insert(const Coordinates &pos, const XChunkLocation &location) {
+    _values.push_back(pos);
+    _locations[pos] = location;
+}
+
 void XIndex::insert(const XIndex &other) {
     std::copy(other.begin(), other.end(), std::back_inserter(_values));
+    _locations.insert(other._locations.begin(), other._locations.end());
+}
+
+bool XIndex::isPacked() const {
+    return _packed;
+}
+
+const XChunkLocation* XIndex::getLocation(const Coordinates &pos) const {
+    auto location = _locations.find(pos);
+    return location == _locations.end() ? NULL : &location->second;
 }
 
 void XIndex::sort() {
     std::sort(_values.begin(), _values.end(), CoordinatesLess());
 }
 
+void XIndex::insertSorted(const Coordinates &pos) {
+    _values.insert(std::upper_bound(_values.begin(), _values.end(), pos,
+                                    CoordinatesLess()),
+                   pos);
+}
+
 void XIndex::load(std::shared_ptr<const Driver> driver,
-                  std::shared_ptr<Query> query) {
+                  std::shared_ptr<Query> query,
+                  std::shared_ptr<const Metadata> metadata) {
     const InstanceID instID = query->getInstanceID();
-
-    // -- - Get Count of Chunk Index Files - --
-    size_t nIndex = driver->count("index/");
-    LOG4CXX_DEBUG(logger, "XINDEX|" << instID << "|load nIndex:" << nIndex);
-
-    // -- - Read Part of Chunk Index Files - --
-    // Divide index files among instnaces
-
     const size_t nInst = query->getInstancesCount();
     const Dimensions dims = _desc.getDimensions();
     const size_t nDims = dims.size();
     scidb::Coordinates pos(nDims);
 
-    // One coordBuf for each instance
-    std::unique_ptr<std::vector<Coordinate>[]> coordBuf= std::make_unique<std::vector<Coordinate>[]>(nInst);
+    // Chunk coordinates followed by the chunk location, if packed
+    std::vector<int64_t> record(_width);
+    auto setRecord = [&](const std::vector<const int64_t*> &columns, size_t j) {
+        for (size_t i = 0; i < _width; i++)
+            record[i] = columns[i][j];
+        std::copy(record.begin(), record.begin() + nDims, pos.begin());
+    };
+    auto insertRecord = [&]() {
+        if (_packed)
+            insert(pos, XChunkLocation{record[nDims],
+                                       record[nDims + 1],
+                                       record[nDims + 2]});
+        else
+            insert(pos);
+    };
+
     ArrowReader arrowReader(Attributes(),
-                            _desc.getDimensions(),
+                            getIndexDimensions(_desc.getDimensions(), _packed),
                             Metadata::Compression::GZIP,
                             driver);
     std::shared_ptr<arrow::RecordBatch> arrowBatch;
+    std::vector<const int64_t*> columns(_width);
 
-    for (size_t iIndex = instID; iIndex < nIndex; iIndex += nInst) {
+    // -- - Partitioned Index - --
+    // Index was partitioned at save time for the same number of
+    // instances, read the objects of the current instance partition
+    if (metadata->getIndexPartition() == nInst) {
+        auto split = metadata->getIndexPartitionSplit();
+        LOG4CXX_DEBUG(logger, "XINDEX|" << instID << "|load partition:["
+                      << split[instID] << "," << split[instID + 1] << ")");
 
-        // Download One Chunk Index
-        std::ostringstream out;
-        out << "index/" << iIndex;
-        std::string objectName(out.str());
-        arrowReader.readObject(objectName, true, arrowBatch);
-        // LOG4CXX_DEBUG(logger, "XINDEX|" << instID << "|load read:" << out.str());
-
-        if (arrowBatch->num_columns() != static_cast<int>(nDims)) {
-            out.str("");
-            out << objectName
-                << " Invalid number of columns";
-            throw SYSTEM_EXCEPTION(scidb::SCIDB_SE_METADATA,
-                                   scidb::SCIDB_LE_UNKNOWN_ERROR)
-                << out.str();
-        }
-        std::vector<const int64_t*> columns(nDims);
-        for (size_t i = 0; i < nDims; i++)
-            columns[i] = std::static_pointer_cast<arrow::Int64Array>(
-                arrowBatch->column(i))->raw_values();
-        size_t columnLen = arrowBatch->column(0)->length();
-
-        for (size_t j = 0; j < columnLen; j++) {
-            for (size_t i = 0; i < nDims; i++)
-                pos[i] = columns[i][j];
-
-            InstanceID primaryID = _desc.getPrimaryInstanceId(pos, nInst);
-            // LOG4CXX_DEBUG(logger, "XINDEX|" << instID << "|load pos:" << pos << " primary:" << primaryID);
-            if (primaryID == instID)
-                insert(pos);
-            else
-                // Serialize in the right coordBuf
-                std::copy(pos.begin(), pos.end(), std::back_inserter(coordBuf[primaryID]));
-        }
+        std::vector<std::string> objectNames;
+        for (size_t iIndex = split[instID];
+             iIndex < split[instID + 1];
+             ++iIndex)
+            objectNames.push_back(indexObjectName(iIndex));
+
+        driver->readEach(
+            objectNames, DRIVER_PENDING_DEFAULT,
+            [&](size_t iObject, std::shared_ptr<arrow::Buffer> buffer) {
+                size_t columnLen = _readObject(
+                    arrowReader, objectNames[iObject], buffer, arrowBatch, columns);
+
+                for (size_t j = 0; j < columnLen; j++) {
+                    setRecord(columns, j);
+                    insertRecord();
+                }
+            });
+
+        sort();
+
+        LOG4CXX_DEBUG(logger, "XINDEX|" << instID << "|load size:" << size());
+        return;
+    }
+
+    // One coordBuf for each instance
+    std::vector<CoordinatesEncoder> coordBuf(nInst, CoordinatesEncoder(_width));
+
+    // Keep coordinates of the current instance, serialize the rest in
+    // the right coordBuf
+    auto place = [&]() {
+        InstanceID primaryID = _desc.getPrimaryInstanceId(pos, nInst);
+        // LOG4CXX_DEBUG(logger, "XINDEX|" << instID << "|load pos:" << pos << " primary:" << primaryID);
+        if (primaryID == instID)
+            insertRecord();
+        else
+            coordBuf[primaryID].append(record.data());
+    };
+
+    if (metadata->getIndexFormat() == Metadata::IndexFormat::INDEX_FENCE) {
+        // -- - Read Part of Record Objects - --
+        // Records are fixed-width and need no decoding
+        XIndexFence fence(dims, driver);
+        size_t nIndex = fence.getObjectCount();
+        LOG4CXX_DEBUG(logger, "XINDEX|" << instID << "|load nIndex:" << nIndex
+                      << " fence");
+
+        std::vector<size_t> iObjects;
+        for (size_t iIndex = instID; iIndex < nIndex; iIndex += nInst)
+            iObjects.push_back(iIndex);
+
+        fence.readObjects(
+            iObjects, [&](const int64_t *fenceRecord, size_t nRecords) {
+                for (size_t j = 0; j < nRecords; j++, fenceRecord += nDims) {
+                    std::copy(fenceRecord, fenceRecord + nDims, record.begin());
+                    std::copy(fenceRecord, fenceRecord + nDims, pos.begin());
+                    place();
+                }
+            });
+    }
+    else {
+        // -- - Get Count of Chunk Index Files - --
+        size_t nIndex = driver->count("index/");
+        LOG4CXX_DEBUG(logger, "XINDEX|" << instID << "|load nIndex:" << nIndex);
+
+        // -- - Read Part of Chunk Index Files - --
+        // Divide index files among instnaces. Download the next index
+        // files while decoding the current one.
+        std::vector<std::string> objectNames;
+        for (size_t iIndex = instID; iIndex < nIndex; iIndex += nInst)
+            objectNames.push_back(indexObjectName(iIndex));
+
+        driver->readEach(
+            objectNames, DRIVER_PENDING_DEFAULT,
+            [&](size_t iObject, std::shared_ptr<arrow::Buffer> buffer) {
+                size_t columnLen = _readObject(
+                    arrowReader, objectNames[iObject], buffer, arrowBatch, columns);
+
+                for (size_t j = 0; j < columnLen; j++) {
+                    setRecord(columns, j);
+                    place();
+                }
+            });
     }
 
     // Distribute Index Splits to Each Instance
     for (InstanceID remoteID = 0; remoteID < nInst; ++remoteID)
         if (remoteID != instID) {
-            // Prepare Shared Buffer
-            std::shared_ptr<SharedBuffer> buf;
-            if (coordBuf[remoteID].size() == 0)
-                buf = std::shared_ptr<SharedBuffer>(new MemoryBuffer(NULL, 1));
-            else
-                buf = std::shared_ptr<SharedBuffer>(
-                    // Have to copy it
-                    new MemoryBuffer(
-                        coordBuf[remoteID].data(),
-                        coordBuf[remoteID].size() * sizeof(Coordinate)));
-
-            // Send Shared Buffer
-            BufSend(remoteID, buf, query);
+            // Send Encoded Shared Buffer
+            BufSend(remoteID, coordBuf[remoteID].finalize(), query);
             // LOG4CXX_DEBUG(logger, "XINDEX|" << instID << "|load send to:" << remoteID);
         }
 
@@ -350,42 +967,104 @@ void XIndex::load(std::shared_ptr<const Driver> driver,
     LOG4CXX_DEBUG(logger, "XINDEX|" << instID << "|load size:" << size());
 }
 
+void XIndex::loadFence(std::shared_ptr<Query> query,
+                       const XIndexFence &fence) {
+    const InstanceID instID = query->getInstanceID();
+    const size_t nInst = query->getInstancesCount();
+    scidb::Coordinates pos(_nDims);
+
+    // -- - Read All Record Objects - --
+    // Keep the coordinates of the current instance only
+    std::vector<size_t> iObjects(fence.getObjectCount());
+    std::iota(iObjects.begin(), iObjects.end(), 0);
+    LOG4CXX_DEBUG(logger, "XINDEX|" << instID << "|loadFence nIndex:"
+                  << iObjects.size());
+
+    fence.readObjects(
+        iObjects, [&](const int64_t *record, size_t nRecords) {
+            for (size_t j = 0; j < nRecords; j++, record += _nDims) {
+                std::copy(record, record + _nDims, pos.begin());
+                if (_desc.getPrimaryInstanceId(pos, nInst) == instID)
+                    insert(pos);
+            }
+        });
+
+    sort();
+
+    LOG4CXX_DEBUG(logger, "XINDEX|" << instID << "|loadFence size:" << size());
+}
+
+size_t XIndex::_readObject(ArrowReader &arrowReader,
+                           const std::string &objectName,
+                           std::shared_ptr<arrow::Buffer> buffer,
+                           std::shared_ptr<arrow::RecordBatch> &arrowBatch,
+                           std::vector<const int64_t*> &columns) const {
+    arrowReader.readBuffer(objectName, buffer, arrowBatch);
+    // LOG4CXX_DEBUG(logger, "XINDEX|load read:" << objectName);
+
+    if (arrowBatch->num_columns() != static_cast<int>(_width)) {
+        std::ostringstream out;
+        out << objectName
+            << " Invalid number of columns";
+        throw SYSTEM_EXCEPTION(scidb::SCIDB_SE_METADATA,
+                               scidb::SCIDB_LE_UNKNOWN_ERROR)
+            << out.str();
+    }
+    for (size_t i = 0; i < _width; i++)
+        columns[i] = std::static_pointer_cast<arrow::Int64Array>(
+            arrowBatch->column(i))->raw_values();
+    return arrowBatch->column(0)->length();
+}
+
 void XIndex::deserialize_insert(std::shared_ptr<SharedBuffer> buf) {
-    // A One Byte Buffer is an "Empty" Buffer
-    if (buf->getSize() == 1)
-        return;
+    const uint8_t *ptr = static_cast<const uint8_t*>(buf->getConstData());
+    const uint8_t *end = ptr + buf->getSize();
 
-    const Coordinate* mem = static_cast<const Coordinate*>(buf->getConstData());
+    uint64_t count;
+    ptr = decodeVarint(ptr, end, count);
+    _values.reserve(_values.size() + count);
 
-    // De-serialize Coordinates
-    for (size_t i = 0; i < buf->getSize() / sizeof(Coordinate) / _nDims; ++i) {
-        Coordinates pos;
-        std::copy(
-            mem + i * _nDims, mem + (i + 1) * _nDims, std::back_inserter(pos));
-        insert(pos);
+    // De-serialize Coordinates, Followed by Chunk Location If Packed
+    std::vector<int64_t> record(_width, 0);
+    Coordinates pos(_nDims);
+    uint64_t value;
+    for (uint64_t i = 0; i < count; ++i) {
+        for (size_t j = 0; j < _width; ++j) {
+            ptr = decodeVarint(ptr, end, value);
+            record[j] = static_cast<int64_t>(
+                static_cast<uint64_t>(record[j]) + ((value >> 1) ^ (~(value & 1) + 1)));
+        }
+        std::copy(record.begin(), record.begin() + _nDims, pos.begin());
+        if (_packed)
+            insert(pos, XChunkLocation{record[_nDims],
+                                       record[_nDims + 1],
+                                       record[_nDims + 2]});
+        else
+            insert(pos);
     }
 }
 
 std::shared_ptr<SharedBuffer> XIndex::serialize() const {
-    // Send one byte if the size of the index to be sent is 0; either
-    // the index is empty or there will be nothing sent after the
-    // filter is applied
-    if (size() == 0)
-        return std::shared_ptr<SharedBuffer>(new MemoryBuffer(NULL, 1));
-
     // Serialize Coordinates
     // ---
-    // MemoryBuffer will alocate the output buffer, memcopy is skipped
-    // because of the NULL. We get a pointer to the buffer and write
-    // the data in it.
-    std::shared_ptr<SharedBuffer> buf(
-        new MemoryBuffer(NULL, size() * _nDims * sizeof(Coordinate)));
-    Coordinate *mem = static_cast<Coordinate*>(buf->getWriteData());
-    int i = 0;
-    for (auto posPtr = begin(); posPtr != end(); ++posPtr, ++i)
-        std::copy(posPtr->begin(), posPtr->end(), mem + i * _nDims);
+    // Coordinates are delta encoded, sorted indexes encode best. An
+    // empty index is encoded in one byte.
+    CoordinatesEncoder encoder(_width);
+    std::vector<int64_t> record(_width);
+    for (auto posPtr = begin(); posPtr != end(); ++posPtr) {
+        if (_packed) {
+            auto location = getLocation(*posPtr);
+            std::copy(posPtr->begin(), posPtr->end(), record.begin());
+            record[_nDims] = location->pack;
+            record[_nDims + 1] = location->offset;
+            record[_nDims + 2] = location->length;
+            encoder.append(record.data());
+        }
+        else
+            encoder.append(posPtr->data());
+    }
 
-    return buf;
+    return encoder.finalize();
 }
 
 const XIndexStore::const_iterator XIndex::begin() const {
@@ -404,6 +1083,223 @@ const XIndexStore::const_iterator XIndex::find(const Coordinates& pos) const {
     return res;
 }
 
+//
+// XIndexFence
+//
+// index/fence layout, in int64 values: version, number of
+// dimensions, number of records, records per page, pages per object,
+// followed by the first record of each page. Records are stored in
+// host byte order (little-endian on supported platforms).
+#define FENCE_VERSION 1
+#define FENCE_HEADER_SIZE 5
+
+// Compare a record with coordinates
+inline int compareRecord(const int64_t *record,
+                         const Coordinates &pos,
+                         size_t nDims) {
+    for (size_t i = 0; i < nDims; ++i)
+        if (record[i] != pos[i])
+            return record[i] < pos[i] ? -1 : 1;
+    return 0;
+}
+
+XIndexFence::XIndexFence(const Dimensions &dims,
+                         std::shared_ptr<const Driver> driver):
+    _nDims(dims.size()),
+    _driver(driver),
+    _currPage(std::numeric_limits<size_t>::max()),
+    _currPageSize(0)
+{
+    size_t length = _driver->readArrow("index/fence", _fence);
+    const int64_t *header = reinterpret_cast<const int64_t*>(_fence->data());
+
+    if (length < FENCE_HEADER_SIZE * sizeof(int64_t)
+        || header[0] != FENCE_VERSION
+        || header[1] != static_cast<int64_t>(_nDims)
+        || header[3] < 1
+        || header[4] < 1) {
+        std::ostringstream out;
+        out << _driver->getURL() << "/index/fence Invalid header";
+        throw SYSTEM_EXCEPTION(scidb::SCIDB_SE_METADATA,
+                               scidb::SCIDB_LE_UNKNOWN_ERROR)
+            << out.str();
+    }
+
+    _nRecords = header[2];
+    _recordsPerPage = header[3];
+    _pagesPerObject = header[4];
+    _nPages = (_nRecords + _recordsPerPage - 1) / _recordsPerPage;
+    _keys = header + FENCE_HEADER_SIZE;
+
+    if (length != (FENCE_HEADER_SIZE + _nPages * _nDims) * sizeof(int64_t)) {
+        std::ostringstream out;
+        out << _driver->getURL() << "/index/fence Invalid size";
+        throw SYSTEM_EXCEPTION(scidb::SCIDB_SE_METADATA,
+                               scidb::SCIDB_LE_UNKNOWN_ERROR)
+            << out.str();
+    }
+}
+
+size_t XIndexFence::size() const {
+    return _nRecords;
+}
+
+size_t XIndexFence::getObjectCount() const {
+    return (_nPages + _pagesPerObject - 1) / _pagesPerObject;
+}
+
+size_t XIndexFence::readObject(size_t iObject,
+                               std::shared_ptr<arrow::Buffer> &buffer) const {
+    size_t length = _driver->readArrow(_objectName(iObject), buffer);
+    return _checkObject(iObject, length);
+}
+
+void XIndexFence::readObjects(
+    const std::vector<size_t> &iObjects,
+    const std::function<void(const int64_t *records,
+                             size_t nRecords)> &process) const {
+    std::vector<std::string> objectNames;
+    for (auto iObject : iObjects)
+        objectNames.push_back(_objectName(iObject));
+
+    _driver->readEach(
+        objectNames, DRIVER_PENDING_DEFAULT,
+        [&](size_t i, std::shared_ptr<arrow::Buffer> buffer) {
+            size_t nRecords = _checkObject(iObjects[i], buffer->size());
+            process(reinterpret_cast<const int64_t*>(buffer->data()), nRecords);
+        });
+}
+
+size_t XIndexFence::_checkObject(size_t iObject, size_t length) const {
+    const size_t recordSize = _nDims * sizeof(int64_t);
+    const size_t recordsPerObject = _recordsPerPage * _pagesPerObject;
+
+    if (length != std::min(recordsPerObject,
+                           _nRecords - iObject * recordsPerObject) * recordSize) {
+        std::ostringstream out;
+        out << _driver->getURL() << "/" << _objectName(iObject)
+            << " Invalid size";
+        throw SYSTEM_EXCEPTION(scidb::SCIDB_SE_METADATA,
+                               scidb::SCIDB_LE_UNKNOWN_ERROR)
+            << out.str();
+    }
+    return length / recordSize;
+}
+
+bool XIndexFence::contains(const Coordinates &pos) {
+    // Find the last page with the first record not after pos
+    size_t low = 0, high = _nPages;
+    while (low < high) {
+        size_t mid = (low + high) / 2;
+        if (compareRecord(_keys + mid * _nDims, pos, _nDims) <= 0)
+            low = mid + 1;
+        else
+            high = mid;
+    }
+    if (low == 0)
+        return false;
+    size_t iPage = low - 1;
+
+    // Read the page using a ranged read
+    if (iPage != _currPage) {
+        const size_t recordSize = _nDims * sizeof(int64_t);
+        size_t iObject = iPage / _pagesPerObject;
+        size_t offset = (iPage % _pagesPerObject) * _recordsPerPage * recordSize;
+        size_t nRecords = std::min(_recordsPerPage,
+                                   _nRecords - iPage * _recordsPerPage);
+
+        size_t length = _driver->readRange(
+            _objectName(iObject), offset, nRecords * recordSize, _page);
+        if (length != nRecords * recordSize) {
+            std::ostringstream out;
+            out << _driver->getURL() << "/" << _objectName(iObject)
+                << " Invalid size";
+            throw SYSTEM_EXCEPTION(scidb::SCIDB_SE_METADATA,
+                                   scidb::SCIDB_LE_UNKNOWN_ERROR)
+                << out.str();
+        }
+        _currPage = iPage;
+        _currPageSize = nRecords;
+        LOG4CXX_DEBUG(logger, "XINDEX|fence read page:" << iPage
+                      << " object:" << iObject << " offset:" << offset);
+    }
+
+    // Binary search the page
+    const int64_t *records = reinterpret_cast<const int64_t*>(_page->data());
+    low = 0;
+    high = _currPageSize;
+    while (low < high) {
+        size_t mid = (low + high) / 2;
+        int res = compareRecord(records + mid * _nDims, pos, _nDims);
+        if (res == 0)
+            return true;
+        if (res < 0)
+            low = mid + 1;
+        else
+            high = mid;
+    }
+    return false;
+}
+
+void XIndexFence::write(std::shared_ptr<const Driver> driver,
+                        size_t nDims,
+                        XIndexStore::const_iterator begin,
+                        XIndexStore::const_iterator end,
+                        size_t indexSplit) {
+    const size_t nRecords = std::distance(begin, end);
+    const size_t recordSize = nDims * sizeof(int64_t);
+    const size_t recordsPerPage = std::max<size_t>(
+        1, INDEX_FENCE_PAGE_SIZE / recordSize);
+    // index_split is the number of coordinates per object
+    const size_t pagesPerObject = std::max<size_t>(
+        1, indexSplit / nDims / recordsPerPage);
+    const size_t recordsPerObject = recordsPerPage * pagesPerObject;
+    const size_t nPages = (nRecords + recordsPerPage - 1) / recordsPerPage;
+
+    std::shared_ptr<arrow::Buffer> fence;
+    THROW_NOT_OK(arrow::AllocateBuffer(
+                     (FENCE_HEADER_SIZE + nPages * nDims) * sizeof(int64_t),
+                     &fence));
+    int64_t *header = reinterpret_cast<int64_t*>(fence->mutable_data());
+    header[0] = FENCE_VERSION;
+    header[1] = nDims;
+    header[2] = nRecords;
+    header[3] = recordsPerPage;
+    header[4] = pagesPerObject;
+    int64_t *keys = header + FENCE_HEADER_SIZE;
+
+    // Write Record Objects
+    DriverWriteQueue writes(driver);
+    size_t iRecord = 0;
+    for (size_t iObject = 0; iRecord < nRecords; ++iObject) {
+        size_t nObjectRecords = std::min(recordsPerObject, nRecords - iRecord);
+
+        std::shared_ptr<arrow::Buffer> buffer;
+        THROW_NOT_OK(arrow::AllocateBuffer(nObjectRecords * recordSize,
+                                           &buffer));
+        int64_t *record = reinterpret_cast<int64_t*>(buffer->mutable_data());
+
+        for (size_t j = 0; j < nObjectRecords; ++j, ++iRecord, ++begin) {
+            std::copy(begin->begin(), begin->end(), record + j * nDims);
+            if (iRecord % recordsPerPage == 0)
+                std::copy(begin->begin(), begin->end(),
+                          keys + iRecord / recordsPerPage * nDims);
+        }
+
+        writes.write(_objectName(iObject), buffer);
+    }
+    writes.wait();
+
+    // Write Fence Last
+    driver->writeArrow("index/fence", fence);
+}
+
+std::string XIndexFence::_objectName(size_t iObject) {
+    std::ostringstream out;
+    out << "index/r_" << iObject;
+    return out.str();
+}
+
 } // namespace scidb
 
 
@@ -28,6 +28,8 @@
 
 #include "Driver.h"
 
+#include <unordered_map>
+
 // SciDB
 #include <array/Coordinate.h>
 #include <array/Dimensions.h>
@@ -41,9 +43,11 @@ namespace scidb {
     class Query;
     class SharedBuffer;
     class XIndex;
+    class XIndexFence;
 }
 namespace arrow {
     class Array;
+    class DataType;
     class RecordBatch;
     class RecordBatchReader;
     class ResizableBuffer;
@@ -68,23 +72,79 @@ namespace scidb {
 // --
 // -- - ArrowReader - --
 // --
+
+// Column layout of chunk objects (Metadata::LAYOUT_COLUMN). Each
+// buffer of each column is compressed on its own, so a column is
+// only decompressed when it is first used. All integers are int64:
+//
+//   column: nBuffers, then for each buffer rawLength (-1 if absent),
+//           storedLength, and the stored bytes, padded to 8 bytes.
+//           Buffers which do not compress are stored as is
+//           (storedLength == rawLength). With a compression filter,
+//           compressed value buffers of fixed-width columns of two
+//           bytes or more are shuffled before compression.
+//   footer: column offsets (nColumns + 1), null counts (nColumns),
+//           nRows, nColumns, and ARROW_COLUMN_MAGIC.
+#define ARROW_COLUMN_MAGIC "XCOLUMN1"
+
 class ArrowReader {
 public:
     ArrowReader(const Attributes&,
                 const Dimensions&,
                 const Metadata::Compression,
-                std::shared_ptr<const Driver>);
+                std::shared_ptr<const Driver>,
+                const Metadata::CompressionLayout=Metadata::LAYOUT_STREAM,
+                const Metadata::CompressionFilter=Metadata::FILTER_NONE);
 
     size_t readObject(const std::string &name,
                       bool reuse,
                       std::shared_ptr<arrow::RecordBatch>&);
 
+    // Codec of each column, for arrays saved with compression AUTO.
+    // Only used by the column layout.
+    void setColumnCompression(const std::vector<Metadata::ColumnCompression>&);
+
+    // Decode an object already read into the buffer
+    void readBuffer(const std::string &name,
+                    std::shared_ptr<arrow::Buffer>,
+                    std::shared_ptr<arrow::RecordBatch>&);
+
     static std::shared_ptr<arrow::Schema> scidb2ArrowSchema(
         const Attributes&, const Dimensions&);
 
+    // Codec for the compression, NULL if none. Arrow has no
+    // streaming support for Snappy, so Snappy objects are compressed
+    // in one block, prefixed by the uncompressed size (int64).
+    static std::unique_ptr<arrow::util::Codec> makeCodec(
+        Metadata::Compression, int level=COMPRESSION_LEVEL_DEFAULT);
+    static bool isBlockCompression(Metadata::Compression);
+
+    // Element width of buffer iBuffer of a column of the type, if the
+    // filter applies to it, 0 otherwise
+    static int filterWidth(Metadata::CompressionFilter,
+                           const arrow::DataType&,
+                           size_t iBuffer);
+
+    // Byte shuffle stores byte 0 of all elements, then byte 1, etc.
+    // Bit shuffle stores bit 0 of all elements, then bit 1, etc., for
+    // groups of 8 elements. Trailing bytes are copied as is.
+    static void shuffle(Metadata::CompressionFilter,
+                        int width,
+                        const uint8_t *in,
+                        int64_t length,
+                        uint8_t *out);
+    static void unshuffle(Metadata::CompressionFilter,
+                          int width,
+                          const uint8_t *in,
+                          int64_t length,
+                          uint8_t *out);
+
 private:
     const std::shared_ptr<arrow::Schema> _schema;
     const Metadata::Compression _compression;
+    const Metadata::CompressionLayout _layout;
+    const Metadata::CompressionFilter _filter;
+    std::vector<Metadata::Compression> _columnCompression;
 
     std::shared_ptr<const Driver> _driver;
 
@@ -93,6 +153,12 @@ private:
     std::unique_ptr<arrow::util::Codec> _arrowCodec;
     std::shared_ptr<arrow::io::CompressedInputStream> _arrowCompressedStream;
     std::shared_ptr<arrow::RecordBatchReader> _arrowBatchReader;
+
+    // Check the footer of an object in column layout and return a
+    // batch which decompresses its columns when used
+    void _readColumns(const std::string &name,
+                     std::shared_ptr<arrow::Buffer>,
+                     std::shared_ptr<arrow::RecordBatch>&);
 };
 
 
@@ -103,18 +169,59 @@ private:
 // Type of XIndex Container
 typedef std::vector<Coordinates> XIndexStore;
 
+// Location of a chunk in a pack object (see Metadata::packObjectName).
+// Stored in the index of packed arrays, after the chunk coordinates.
+struct XChunkLocation {
+    int64_t pack;
+    int64_t offset;
+    int64_t length;
+};
+#define XINDEX_LOCATION_SIZE 3      // Number of int64 in XChunkLocation
+
 class XIndex {
 
   public:
-    XIndex(const ArrayDesc&);
+    // Indexes of packed arrays hold the location of each chunk
+    XIndex(const ArrayDesc&, bool packed=false);
 
     size_t size() const;
+
+    // Estimated memory used by the coordinates and, if packed, by the
+    // chunk locations, in bytes
+    size_t memorySize() const;
+
     void insert(const Coordinates&);
+    void insert(const Coordinates&, const XChunkLocation&);
     void insert(const XIndex&);
     void sort();
 
+    bool isPacked() const;
+
+    // Return the location of the chunk, NULL if not found
+    const XChunkLocation* getLocation(const Coordinates&) const;
+
+    // Dimensions of the index objects, the array dimensions followed,
+    // for packed arrays, by the chunk location fields
+    static Dimensions getIndexDimensions(const Dimensions&, bool packed);
+
+    // Insert and keep the index sorted. Used for indexes built
+    // incrementally while being searched.
+    void insertSorted(const Coordinates&);
+
 
-    void load(std::shared_ptr<const Driver>, std::shared_ptr<Query>);
+    // Load the index part of the current instance. If the index is
+    // partitioned for the current number of instances, only the
+    // objects of the current instance partition are read and no
+    // coordinates are exchanged between instances.
+    void load(std::shared_ptr<const Driver>,
+              std::shared_ptr<Query>,
+              std::shared_ptr<const Metadata>);
+
+    // Load the index part of the current instance from the record
+    // objects of a fence index. All the record objects are read and
+    // the coordinates of the other instances are dropped, so no
+    // coordinates are exchanged and instances can load on their own.
+    void loadFence(std::shared_ptr<Query>, const XIndexFence&);
 
     // Serialize & De-serialize for inter-instance comms
     std::shared_ptr<SharedBuffer> serialize() const;
@@ -126,11 +233,92 @@ class XIndex {
     const XIndexStore::const_iterator find(const Coordinates&) const;
 
   private:
-    const ArrayDesc& _desc;
+    // Copy of the schema, the index might outlive the query (see
+    // XInputCache)
+    const ArrayDesc _desc;
     const Dimensions& _dims;
     const size_t _nDims;
+    const bool _packed;
+
+    // Number of int64 values stored for each chunk
+    const size_t _width;
 
     XIndexStore _values;
+    std::unordered_map<Coordinates, XChunkLocation, CoordinatesHash> _locations;
+
+    // Decode one index object read into the buffer and set columns
+    // to its coordinate columns, followed by the chunk location
+    // columns, if packed. Returns the number of coordinates.
+    size_t _readObject(ArrowReader&,
+                       const std::string &objectName,
+                       std::shared_ptr<arrow::Buffer>,
+                       std::shared_ptr<arrow::RecordBatch>&,
+                       std::vector<const int64_t*> &columns) const;
+};
+
+
+// --
+// -- - XIndexFence - --
+// --
+
+// Index stored as sorted fixed-width records, one int64 per
+// dimension, in index/r_<k> objects. Records are grouped in pages of
+// about INDEX_FENCE_PAGE_SIZE bytes. The first coordinates of each
+// page (fence pointers) are stored in index/fence, so a lookup only
+// reads the fence and one page.
+class XIndexFence {
+
+  public:
+    // Read the fence object
+    XIndexFence(const Dimensions&, std::shared_ptr<const Driver>);
+
+    // Number of records
+    size_t size() const;
+    size_t getObjectCount() const;
+
+    // Read the records of one object. Returns the number of records
+    // read.
+    size_t readObject(size_t iObject, std::shared_ptr<arrow::Buffer>&) const;
+
+    // Read all the objects, with several requests outstanding, and
+    // process the records of each object
+    void readObjects(
+        const std::vector<size_t> &iObjects,
+        const std::function<void(const int64_t *records,
+                                 size_t nRecords)> &process) const;
+
+    // Binary search the fence and then the page which might hold
+    // the coordinates. The last page read is kept, so lookups in
+    // sorted order read each page once.
+    bool contains(const Coordinates&);
+
+    // Write sorted coordinates as record and fence objects
+    static void write(std::shared_ptr<const Driver>,
+                      size_t nDims,
+                      XIndexStore::const_iterator begin,
+                      XIndexStore::const_iterator end,
+                      size_t indexSplit);
+
+  private:
+    const size_t _nDims;
+    std::shared_ptr<const Driver> _driver;
+
+    size_t _nRecords;
+    size_t _recordsPerPage;
+    size_t _pagesPerObject;
+    size_t _nPages;
+
+    std::shared_ptr<arrow::Buffer> _fence;
+    const int64_t *_keys;
+
+    size_t _currPage;
+    size_t _currPageSize;
+    std::shared_ptr<arrow::Buffer> _page;
+
+    static std::string _objectName(size_t iObject);
+
+    // Check the size of an object. Returns the number of records.
+    size_t _checkObject(size_t iObject, size_t length) const;
 };
 } // namespace scidb
 
@@ -0,0 +1,187 @@
+/*
+**
+* BEGIN_COPYRIGHT
+*
+* Copyright (C) 2020-2021 Paradigm4 Inc.
+* All Rights Reserved.
+*
+* bridge is a plugin for SciDB, an Open Source Array DBMS maintained
+* by Paradigm4. See http://www.paradigm4.com/
+*
+* bridge is free software: you can redistribute it and/or modify
+* it under the terms of the AFFERO GNU General Public License as published by
+* the Free Software Foundation.
+*
+* bridge is distributed "AS-IS" AND WITHOUT ANY WARRANTY OF ANY KIND,
+* INCLUDING ANY IMPLIED WARRANTY OF MERCHANTABILITY,
+* NON-INFRINGEMENT, OR FITNESS FOR A PARTICULAR PURPOSE. See
+* the AFFERO GNU General Public License for the complete license terms.
+*
+* You should have received a copy of the AFFERO GNU General Public License
+* along with bridge.  If not, see <http://www.gnu.org/licenses/agpl-3.0.html>
+*
+* END_COPYRIGHT
+*/
+
+#include "XInputCache.h"
+
+#include <log4cxx/logger.h>
+
+// SciDB
+#include <array/MemoryBuffer.h>
+#include <network/Network.h>
+#include <query/Query.h>
+
+
+namespace scidb {
+
+static log4cxx::LoggerPtr logger(log4cxx::Logger::getLogger("scidb.xinputcache"));
+
+//
+// XInputCache
+//
+XInputCache::XInputCache():
+    _size(0)
+{}
+
+XInputCache& XInputCache::getInstance() {
+    static XInputCache instance;
+    return instance;
+}
+
+std::shared_ptr<Metadata> XInputCache::getMetadata(const std::string &url,
+                                                   const std::string &eTag) {
+    std::lock_guard<std::mutex> lock(_lock);
+
+    auto entryPair = _entries.find(url);
+    if (entryPair == _entries.end()
+        || entryPair->second.eTag != eTag
+        || entryPair->second.metadata == NULL) {
+        LOG4CXX_DEBUG(logger, "XINPUTCACHE||getMetadata miss:" << url);
+        return NULL;
+    }
+
+    LOG4CXX_DEBUG(logger, "XINPUTCACHE||getMetadata hit:" << url);
+    // Return a copy, metadata is not thread-safe
+    return std::make_shared<Metadata>(*entryPair->second.metadata);
+}
+
+void XInputCache::setMetadata(const std::string &url,
+                              const std::string &eTag,
+                              std::shared_ptr<const Metadata> metadata) {
+    std::lock_guard<std::mutex> lock(_lock);
+
+    _getEntry(url, eTag).metadata = std::make_shared<Metadata>(*metadata);
+}
+
+std::shared_ptr<const XIndex> XInputCache::getIndex(const std::string &url,
+                                                    const std::string &eTag,
+                                                    size_t nInst,
+                                                    InstanceID instID) {
+    std::lock_guard<std::mutex> lock(_lock);
+
+    auto entryPair = _entries.find(url);
+    if (entryPair == _entries.end()
+        || entryPair->second.eTag != eTag
+        || entryPair->second.index == NULL
+        || entryPair->second.nInst != nInst
+        || entryPair->second.instID != instID) {
+        LOG4CXX_DEBUG(logger, "XINPUTCACHE|" << instID << "|getIndex miss:" << url);
+        return NULL;
+    }
+
+    // Mark as Most Recently Used
+    Entry &entry = entryPair->second;
+    _lru.splice(_lru.begin(), _lru, entry.lru);
+
+    LOG4CXX_DEBUG(logger, "XINPUTCACHE|" << instID << "|getIndex hit:" << url);
+    return entry.index;
+}
+
+void XInputCache::setIndex(const std::string &url,
+                           const std::string &eTag,
+                           size_t nInst,
+                           InstanceID instID,
+                           std::shared_ptr<const XIndex> index) {
+    // Estimated memory used by the index
+    size_t size = index->memorySize();
+
+    if (size > INPUT_CACHE_SIZE) {
+        LOG4CXX_DEBUG(logger, "XINPUTCACHE|" << instID << "|setIndex skip:" << url
+                      << " size:" << size);
+        return;
+    }
+
+    std::lock_guard<std::mutex> lock(_lock);
+
+    Entry &entry = _getEntry(url, eTag);
+    _size -= entry.size;
+    entry.nInst = nInst;
+    entry.instID = instID;
+    entry.index = index;
+    entry.size = size;
+    _size += size;
+
+    // Evict Least Recently Used Indexes
+    while (_size > INPUT_CACHE_SIZE) {
+        Entry &last = _entries.at(_lru.back());
+        LOG4CXX_DEBUG(logger, "XINPUTCACHE|" << instID << "|setIndex evict:"
+                      << _lru.back() << " size:" << _size);
+        _size -= last.size;
+        _entries.erase(_lru.back());
+        _lru.pop_back();
+    }
+
+    LOG4CXX_DEBUG(logger, "XINPUTCACHE|" << instID << "|setIndex add:" << url
+                  << " size:" << _size);
+}
+
+bool XInputCache::allInstances(bool flag, std::shared_ptr<Query> query) {
+    const InstanceID instID = query->getInstanceID();
+    const size_t nInst = query->getInstancesCount();
+
+    std::shared_ptr<SharedBuffer> buf(new MemoryBuffer(NULL, 1));
+    *static_cast<char*>(buf->getWriteData()) = flag;
+
+    for (InstanceID remoteID = 0; remoteID < nInst; ++remoteID)
+        if (remoteID != instID)
+            BufSend(remoteID, buf, query);
+
+    // Receive from all instances, even after a false flag
+    for (InstanceID remoteID = 0; remoteID < nInst; ++remoteID)
+        if (remoteID != instID)
+            flag = *static_cast<const char*>(
+                BufReceive(remoteID, query)->getConstData()) && flag;
+
+    return flag;
+}
+
+XInputCache::Entry& XInputCache::_getEntry(const std::string &url,
+                                           const std::string &eTag) {
+    auto entryPair = _entries.find(url);
+    if (entryPair != _entries.end()) {
+        Entry &entry = entryPair->second;
+        _lru.splice(_lru.begin(), _lru, entry.lru);
+
+        // Reset Stale Entry
+        if (entry.eTag != eTag) {
+            _size -= entry.size;
+            entry.eTag = eTag;
+            entry.metadata.reset();
+            entry.index.reset();
+            entry.size = 0;
+        }
+        return entry;
+    }
+
+    _lru.push_front(url);
+    Entry &entry = _entries[url];
+    entry.eTag = eTag;
+    entry.nInst = 0;
+    entry.instID = 0;
+    entry.size = 0;
+    entry.lru = _lru.begin();
+    return entry;
+}
+
+} // namespace scidb
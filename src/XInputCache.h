@@ -0,0 +1,106 @@
+/*
+**
+* BEGIN_COPYRIGHT
+*
+* Copyright (C) 2020-2021 Paradigm4 Inc.
+* All Rights Reserved.
+*
+* bridge is a plugin for SciDB, an Open Source Array DBMS maintained
+* by Paradigm4. See http://www.paradigm4.com/
+*
+* bridge is free software: you can redistribute it and/or modify
+* it under the terms of the AFFERO GNU General Public License as published by
+* the Free Software Foundation.
+*
+* bridge is distributed "AS-IS" AND WITHOUT ANY WARRANTY OF ANY KIND,
+* INCLUDING ANY IMPLIED WARRANTY OF MERCHANTABILITY,
+* NON-INFRINGEMENT, OR FITNESS FOR A PARTICULAR PURPOSE. See
+* the AFFERO GNU General Public License for the complete license terms.
+*
+* You should have received a copy of the AFFERO GNU General Public License
+* along with bridge.  If not, see <http://www.gnu.org/licenses/agpl-3.0.html>
+*
+* END_COPYRIGHT
+*/
+
+#ifndef X_INPUT_CACHE_H_
+#define X_INPUT_CACHE_H_
+
+#include "Driver.h"
+#include "XIndex.h"
+
+#include <list>
+#include <mutex>
+#include <unordered_map>
+
+
+#define INPUT_CACHE_SIZE 268435456 // 256MB in Bytes
+
+
+namespace scidb {
+
+// --
+// -- - XInputCache - --
+// --
+
+// Instance-wide cache of array metadata (with the schema parsed) and
+// of the index part of the instance, shared across queries. Entries
+// are keyed by URL and are only valid for the driver ETag they were
+// read with. Least recently used entries are evicted once the
+// estimated size of the cached indexes exceeds INPUT_CACHE_SIZE.
+class XInputCache {
+public:
+    static XInputCache& getInstance();
+
+    // Return a copy of the cached metadata, NULL if missing or stale
+    std::shared_ptr<Metadata> getMetadata(const std::string &url,
+                                          const std::string &eTag);
+
+    void setMetadata(const std::string &url,
+                     const std::string &eTag,
+                     std::shared_ptr<const Metadata>);
+
+    // Return the cached index part for the instance, NULL if missing,
+    // stale, or loaded for a different number of instances
+    std::shared_ptr<const XIndex> getIndex(const std::string &url,
+                                           const std::string &eTag,
+                                           size_t nInst,
+                                           InstanceID instID);
+
+    void setIndex(const std::string &url,
+                  const std::string &eTag,
+                  size_t nInst,
+                  InstanceID instID,
+                  std::shared_ptr<const XIndex>);
+
+    // Return true if the flag is true on all the instances. Used to
+    // make all the instances either use their cached index or load
+    // the index, since loading exchanges data between instances.
+    static bool allInstances(bool flag, std::shared_ptr<Query>);
+
+private:
+    struct Entry {
+        std::string eTag;
+        std::shared_ptr<const Metadata> metadata;
+        size_t nInst;
+        InstanceID instID;
+        std::shared_ptr<const XIndex> index;
+        size_t size;
+        std::list<std::string>::iterator lru;
+    };
+
+    std::mutex _lock;
+    std::unordered_map<std::string, Entry> _entries;
+    std::list<std::string> _lru; // Most recently used first
+    size_t _size;
+
+    XInputCache();
+
+    // Return entry for the URL and ETag, reset the entry if stale.
+    // Requires lock.
+    Entry& _getEntry(const std::string &url, const std::string &eTag);
+};
+
+} // namespace scidb
+
+#endif  // XInputCache
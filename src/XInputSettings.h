@@ -41,6 +41,9 @@ static log4cxx::LoggerPtr logger(log4cxx::Logger::getLogger("scidb.operators.xin
 
 static const char* const KW_FORMAT	  = "format";
 static const char* const KW_CACHE_SIZE	  = "cache_size";
+// Set by the coordinator, not by users
+static const char* const KW_METADATA	  = "_metadata";
+static const char* const KW_ETAG	  = "_etag";
 
 typedef std::shared_ptr<OperatorParamLogicalExpression> ParamType_t ;
 
@@ -55,6 +58,9 @@ private:
     std::string			_url;
     FormatType                  _format;
     size_t                      _cacheSize;
+    bool                        _hasMetadata;
+    std::string                 _metadata;
+    std::string                 _eTag;
 
     void setParamFormat(std::vector<std::string> format)
     {
@@ -74,6 +80,17 @@ private:
         _cacheSize = cacheSize[0];
     }
 
+    void setParamMetadata(std::vector<std::string> metadata)
+    {
+        _metadata = metadata[0];
+        _hasMetadata = true;
+    }
+
+    void setParamETag(std::vector<std::string> eTag)
+    {
+        _eTag = eTag[0];
+    }
+
     Parameter getKeywordParam(KeywordParameters const& kwp, const std::string& kw) const
     {
         auto const& kwPair = kwp.find(kw);
@@ -176,7 +193,8 @@ public:
                    bool logical,
                    const std::shared_ptr<Query>& query):
                 _format(ARROW),
-                _cacheSize(CACHE_SIZE_DEFAULT)
+                _cacheSize(CACHE_SIZE_DEFAULT),
+                _hasMetadata(false)
     {
         if (operatorParameters.size() != 1)
             throw USER_EXCEPTION(SCIDB_SE_METADATA, SCIDB_LE_ILLEGAL_OPERATION)
@@ -189,6 +207,8 @@ public:
 
         setKeywordParamString(kwParams, KW_FORMAT,        &XInputSettings::setParamFormat);
         setKeywordParamInt64( kwParams, KW_CACHE_SIZE,    &XInputSettings::setParamCacheSize);
+        setKeywordParamString(kwParams, KW_METADATA,      &XInputSettings::setParamMetadata);
+        setKeywordParamString(kwParams, KW_ETAG,          &XInputSettings::setParamETag);
     }
 
     const std::string& getURL() const
@@ -205,6 +225,23 @@ public:
     {
         return _cacheSize;
     }
+
+    // Metadata read by the coordinator and shipped with the plan
+    bool hasMetadata() const
+    {
+        return _hasMetadata;
+    }
+
+    const std::string& getMetadata() const
+    {
+        return _metadata;
+    }
+
+    // Driver ETag the metadata was read with
+    const std::string& getETag() const
+    {
+        return _eTag;
+    }
 };
 
 } // namespace scidb
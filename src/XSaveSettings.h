@@ -42,7 +42,24 @@ static const char* const KW_NS     	= "namespace";
 static const char* const KW_UPDATE	= "update";
 static const char* const KW_FORMAT	= "format";
 static const char* const KW_COMPRESSION	= "compression";
+static const char* const KW_COMPRESSION_LEVEL	= "compression_level";
+static const char* const KW_COMPRESSION_LAYOUT	= "compression_layout";
+static const char* const KW_COMPRESSION_FILTER	= "compression_filter";
 static const char* const KW_INDEX_SPLIT	= "index_split";
+static const char* const KW_INDEX_PARTITION	= "index_partition";
+static const char* const KW_INDEX_FORMAT	= "index_format";
+static const char* const KW_CHUNK_FANOUT	= "chunk_fanout";
+static const char* const KW_PACK_SIZE	= "pack_size";
+
+// Compression levels accepted by the codecs. Out of range levels are
+// rejected by zlib only when compressing and are clamped by zstd and
+// lz4, so they are checked before anything is written.
+#define COMPRESSION_LEVEL_GZIP_MIN 0
+#define COMPRESSION_LEVEL_GZIP_MAX 9
+#define COMPRESSION_LEVEL_ZSTD_MIN 1
+#define COMPRESSION_LEVEL_ZSTD_MAX 22
+#define COMPRESSION_LEVEL_LZ4_MIN 0
+#define COMPRESSION_LEVEL_LZ4_MAX 12
 
 typedef std::shared_ptr<OperatorParamLogicalExpression> ParamType_t;
 
@@ -54,7 +71,15 @@ private:
     bool                   _isUpdate;
     Metadata::Format       _format;
     Metadata::Compression  _compression;
+    int                    _compressionLevel;
+    Metadata::CompressionLayout _compressionLayout;
+    Metadata::CompressionFilter _compressionFilter;
+    std::vector<Metadata::ColumnCompression> _columnCompression;
     size_t                 _indexSplit;
+    size_t                 _indexPartition;
+    Metadata::IndexFormat  _indexFormat;
+    size_t                 _chunkFanout;
+    size_t                 _packSize;
 
     void failIfUpdate(std::string param) {
         if (_isUpdate) {
@@ -92,11 +117,55 @@ private:
             _compression = Metadata::Compression::NONE;
         else if (compression[0] == "gzip")
             _compression = Metadata::Compression::GZIP;
+        else if (compression[0] == "zstd")
+            _compression = Metadata::Compression::ZSTD;
+        else if (compression[0] == "lz4")
+            _compression = Metadata::Compression::LZ4;
+        else if (compression[0] == "snappy")
+            _compression = Metadata::Compression::SNAPPY;
+        else if (compression[0] == "auto")
+            _compression = Metadata::Compression::AUTO;
         else
             throw USER_EXCEPTION(SCIDB_SE_METADATA, SCIDB_LE_ILLEGAL_OPERATION)
                 << "unsupported compression";
     }
 
+    void setParamCompressionLevel(std::vector<int64_t> compressionLevel) {
+        failIfUpdate("compression_level");
+
+        if (compressionLevel[0] < std::numeric_limits<int>::min() + 1
+            || compressionLevel[0] > std::numeric_limits<int>::max())
+            throw USER_EXCEPTION(SCIDB_SE_METADATA, SCIDB_LE_ILLEGAL_OPERATION)
+                << "compression_level out of range";
+        _compressionLevel = compressionLevel[0];
+    }
+
+    void setParamCompressionLayout(std::vector<std::string> compressionLayout) {
+        failIfUpdate("compression_layout");
+
+        if (compressionLayout[0] == "stream")
+            _compressionLayout = Metadata::CompressionLayout::LAYOUT_STREAM;
+        else if (compressionLayout[0] == "column")
+            _compressionLayout = Metadata::CompressionLayout::LAYOUT_COLUMN;
+        else
+            throw USER_EXCEPTION(SCIDB_SE_METADATA, SCIDB_LE_ILLEGAL_OPERATION)
+                << "compression_layout must be 'stream' or 'column'";
+    }
+
+    void setParamCompressionFilter(std::vector<std::string> compressionFilter) {
+        failIfUpdate("compression_filter");
+
+        if (compressionFilter[0] == "none")
+            _compressionFilter = Metadata::CompressionFilter::FILTER_NONE;
+        else if (compressionFilter[0] == "shuffle")
+            _compressionFilter = Metadata::CompressionFilter::FILTER_SHUFFLE;
+        else if (compressionFilter[0] == "bitshuffle")
+            _compressionFilter = Metadata::CompressionFilter::FILTER_BITSHUFFLE;
+        else
+            throw USER_EXCEPTION(SCIDB_SE_METADATA, SCIDB_LE_ILLEGAL_OPERATION)
+                << "compression_filter must be 'none', 'shuffle', or 'bitshuffle'";
+    }
+
     void setParamIndexSplit(std::vector<int64_t> indexSplit) {
         failIfUpdate("index_split");
 
@@ -108,6 +177,49 @@ private:
         }
     }
 
+    void setParamIndexPartition(std::vector<int64_t> indexPartition) {
+        failIfUpdate("index_partition");
+
+        if(indexPartition[0] < 0)
+            throw USER_EXCEPTION(SCIDB_SE_METADATA, SCIDB_LE_ILLEGAL_OPERATION)
+                << "index_partition must be at or above 0";
+        _indexPartition = indexPartition[0];
+    }
+
+    void setParamIndexFormat(std::vector<std::string> indexFormat) {
+        failIfUpdate("index_format");
+
+        if (indexFormat[0] == "arrow")
+            _indexFormat = Metadata::IndexFormat::INDEX_ARROW;
+        else if (indexFormat[0] == "fence")
+            _indexFormat = Metadata::IndexFormat::INDEX_FENCE;
+        else
+            throw USER_EXCEPTION(SCIDB_SE_METADATA, SCIDB_LE_ILLEGAL_OPERATION)
+                << "index_format must be 'arrow' or 'fence'";
+    }
+
+    void setParamChunkFanout(std::vector<int64_t> chunkFanout) {
+        failIfUpdate("chunk_fanout");
+
+        if(chunkFanout[0] < 0 || chunkFanout[0] > CHUNK_FANOUT_MAX) {
+            std::ostringstream err;
+            err << "chunk_fanout must be between 0 and " << CHUNK_FANOUT_MAX;
+            throw USER_EXCEPTION(SCIDB_SE_METADATA, SCIDB_LE_ILLEGAL_OPERATION) << err.str();
+        }
+        _chunkFanout = chunkFanout[0];
+    }
+
+    void setParamPackSize(std::vector<int64_t> packSize) {
+        failIfUpdate("pack_size");
+
+        if(packSize[0] < 0 || packSize[0] > CHUNK_MAX_SIZE) {
+            std::ostringstream err;
+            err << "pack_size must be between 0 and " << CHUNK_MAX_SIZE;
+            throw USER_EXCEPTION(SCIDB_SE_METADATA, SCIDB_LE_ILLEGAL_OPERATION) << err.str();
+        }
+        _packSize = packSize[0];
+    }
+
     Parameter getKeywordParam(KeywordParameters const& kwp, const std::string& kw) const {
         auto const& kwPair = kwp.find(kw);
         return kwPair == kwp.end() ? Parameter() : kwPair->second;
@@ -290,7 +402,14 @@ public:
         _isUpdate(false),
         _format(Metadata::Format::ARROW),
         _compression(Metadata::Compression::NONE),
-        _indexSplit(INDEX_SPLIT_DEFAULT) {
+        _compressionLevel(COMPRESSION_LEVEL_DEFAULT),
+        _compressionLayout(Metadata::CompressionLayout::LAYOUT_STREAM),
+        _compressionFilter(Metadata::CompressionFilter::FILTER_NONE),
+        _indexSplit(INDEX_SPLIT_DEFAULT),
+        _indexPartition(0),
+        _indexFormat(Metadata::IndexFormat::INDEX_ARROW),
+        _chunkFanout(0),
+        _packSize(0) {
         if (operatorParameters.size() != 1)
             throw USER_EXCEPTION(SCIDB_SE_METADATA, SCIDB_LE_ILLEGAL_OPERATION) << "illegal number of parameters passed to xsave";
         std::shared_ptr<OperatorParam>const& param = operatorParameters[0];
@@ -303,7 +422,72 @@ public:
         setKeywordParamBool     ( kwParams, KW_UPDATE,      &XSaveSettings::setParamUpdate);
         setKeywordParamString   ( kwParams, KW_FORMAT,      &XSaveSettings::setParamFormat);
         setKeywordParamString   ( kwParams, KW_COMPRESSION, &XSaveSettings::setParamCompression);
+        setKeywordParamInt64    ( kwParams, KW_COMPRESSION_LEVEL, &XSaveSettings::setParamCompressionLevel);
+        setKeywordParamString   ( kwParams, KW_COMPRESSION_LAYOUT, &XSaveSettings::setParamCompressionLayout);
+        setKeywordParamString   ( kwParams, KW_COMPRESSION_FILTER, &XSaveSettings::setParamCompressionFilter);
         setKeywordParamInt64    ( kwParams, KW_INDEX_SPLIT, &XSaveSettings::setParamIndexSplit);
+        setKeywordParamInt64    ( kwParams, KW_INDEX_PARTITION, &XSaveSettings::setParamIndexPartition);
+        setKeywordParamString   ( kwParams, KW_INDEX_FORMAT, &XSaveSettings::setParamIndexFormat);
+        setKeywordParamInt64    ( kwParams, KW_CHUNK_FANOUT, &XSaveSettings::setParamChunkFanout);
+        setKeywordParamInt64    ( kwParams, KW_PACK_SIZE,   &XSaveSettings::setParamPackSize);
+
+        if (_indexPartition > 0
+            && _indexFormat == Metadata::IndexFormat::INDEX_FENCE)
+            throw USER_EXCEPTION(SCIDB_SE_METADATA, SCIDB_LE_ILLEGAL_OPERATION)
+                << "index_partition cannot be used with index_format 'fence'";
+
+        if (_packSize > 0
+            && _indexFormat == Metadata::IndexFormat::INDEX_FENCE)
+            throw USER_EXCEPTION(SCIDB_SE_METADATA, SCIDB_LE_ILLEGAL_OPERATION)
+                << "pack_size cannot be used with index_format 'fence'";
+
+        if (_compression == Metadata::Compression::AUTO) {
+            // Codecs Are Chosen per Column
+            if (kwParams.find(KW_COMPRESSION_LAYOUT) != kwParams.end()
+                && _compressionLayout != Metadata::CompressionLayout::LAYOUT_COLUMN)
+                throw USER_EXCEPTION(SCIDB_SE_METADATA, SCIDB_LE_ILLEGAL_OPERATION)
+                    << "compression 'auto' requires compression_layout 'column'";
+            _compressionLayout = Metadata::CompressionLayout::LAYOUT_COLUMN;
+        }
+
+        if (_compressionLevel != COMPRESSION_LEVEL_DEFAULT
+            && (_compression == Metadata::Compression::NONE
+                || _compression == Metadata::Compression::SNAPPY
+                || _compression == Metadata::Compression::AUTO))
+            throw USER_EXCEPTION(SCIDB_SE_METADATA, SCIDB_LE_ILLEGAL_OPERATION)
+                << "compression_level requires compression 'gzip', 'zstd', or 'lz4'";
+
+        if (_compressionLevel != COMPRESSION_LEVEL_DEFAULT) {
+            int minLevel, maxLevel;
+            std::string name;
+            if (_compression == Metadata::Compression::GZIP) {
+                minLevel = COMPRESSION_LEVEL_GZIP_MIN;
+                maxLevel = COMPRESSION_LEVEL_GZIP_MAX;
+                name = "gzip";
+            }
+            else if (_compression == Metadata::Compression::ZSTD) {
+                minLevel = COMPRESSION_LEVEL_ZSTD_MIN;
+                maxLevel = COMPRESSION_LEVEL_ZSTD_MAX;
+                name = "zstd";
+            }
+            else {
+                minLevel = COMPRESSION_LEVEL_LZ4_MIN;
+                maxLevel = COMPRESSION_LEVEL_LZ4_MAX;
+                name = "lz4";
+            }
+            if (_compressionLevel < minLevel || _compressionLevel > maxLevel) {
+                std::ostringstream err;
+                err << "compression_level must be between " << minLevel
+                    << " and " << maxLevel << " for compression '" << name << "'";
+                throw USER_EXCEPTION(SCIDB_SE_METADATA, SCIDB_LE_ILLEGAL_OPERATION) << err.str();
+            }
+        }
+
+        if (_compressionFilter != Metadata::CompressionFilter::FILTER_NONE
+            && (_compression == Metadata::Compression::NONE
+                || _compressionLayout != Metadata::CompressionLayout::LAYOUT_COLUMN))
+            throw USER_EXCEPTION(SCIDB_SE_METADATA, SCIDB_LE_ILLEGAL_OPERATION)
+                << "compression_filter requires a compression and compression_layout 'column'";
     }
 
     const std::string& getURL() const {
@@ -331,6 +515,45 @@ public:
         _compression = compression;
     }
 
+    // Codec default if COMPRESSION_LEVEL_DEFAULT
+    int getCompressionLevel() const {
+        return _compressionLevel;
+    }
+
+    // Used by Updates
+    void setCompressionLevel(int compressionLevel) {
+        _compressionLevel = compressionLevel;
+    }
+
+    Metadata::CompressionLayout getCompressionLayout() const {
+        return _compressionLayout;
+    }
+
+    // Used by Updates
+    void setCompressionLayout(Metadata::CompressionLayout compressionLayout) {
+        _compressionLayout = compressionLayout;
+    }
+
+    Metadata::CompressionFilter getCompressionFilter() const {
+        return _compressionFilter;
+    }
+
+    // Used by Updates
+    void setCompressionFilter(Metadata::CompressionFilter compressionFilter) {
+        _compressionFilter = compressionFilter;
+    }
+
+    // Codec of each column, chosen by sampling for compression AUTO.
+    // Empty until chosen.
+    const std::vector<Metadata::ColumnCompression>& getColumnCompression() const {
+        return _columnCompression;
+    }
+
+    void setColumnCompression(
+        const std::vector<Metadata::ColumnCompression> &columnCompression) {
+        _columnCompression = columnCompression;
+    }
+
     size_t getIndexSplit() const {
         return _indexSplit;
     }
@@ -339,6 +562,42 @@ public:
     void setIndexSplit(int indexSplit) {
         _indexSplit = indexSplit;
     }
+
+    // Number of instances to partition the index for, 0 for no
+    // partitioning
+    size_t getIndexPartition() const {
+        return _indexPartition;
+    }
+
+    // Used by Updates
+    void setIndexPartition(size_t indexPartition) {
+        _indexPartition = indexPartition;
+    }
+
+    Metadata::IndexFormat getIndexFormat() const {
+        return _indexFormat;
+    }
+
+    // Used by Updates
+    void setIndexFormat(Metadata::IndexFormat indexFormat) {
+        _indexFormat = indexFormat;
+    }
+
+    // Number of chunk sub-directories, 0 for none
+    size_t getChunkFanout() const {
+        return _chunkFanout;
+    }
+
+    // Used by Updates
+    void setChunkFanout(size_t chunkFanout) {
+        _chunkFanout = chunkFanout;
+    }
+
+    // Target size of the objects chunks are packed into, 0 for one
+    // object per chunk
+    size_t getPackSize() const {
+        return _packSize;
+    }
 };
 
 } // namespace scidb
@@ -0,0 +1,171 @@
+/*
+**
+* BEGIN_COPYRIGHT
+*
+* Copyright (C) 2020-2021 Paradigm4 Inc.
+* All Rights Reserved.
+*
+* bridge is a plugin for SciDB, an Open Source Array DBMS maintained
+* by Paradigm4. See http://www.paradigm4.com/
+*
+* bridge is free software: you can redistribute it and/or modify
+* it under the terms of the AFFERO GNU General Public License as published by
+* the Free Software Foundation.
+*
+* bridge is distributed "AS-IS" AND WITHOUT ANY WARRANTY OF ANY KIND,
+* INCLUDING ANY IMPLIED WARRANTY OF MERCHANTABILITY,
+* NON-INFRINGEMENT, OR FITNESS FOR A PARTICULAR PURPOSE. See
+* the AFFERO GNU General Public License for the complete license terms.
+*
+* You should have received a copy of the AFFERO GNU General Public License
+* along with bridge.  If not, see <http://www.gnu.org/licenses/agpl-3.0.html>
+*
+* END_COPYRIGHT
+*/
+
+// Unit tests of the AIMD limit arithmetic, run by "make test"
+
+#include "AIMDLimit.h"
+
+#include <cmath>
+#include <iostream>
+
+
+#define CHECK(condition)                                                \
+    {                                                                   \
+        if (!(condition)) {                                             \
+            std::cerr << __FILE__ << ":" << __LINE__                    \
+                      << " check failed: " << #condition << std::endl;  \
+            failures++;                                                 \
+        }                                                               \
+    }
+
+using namespace scidb;
+
+static int failures = 0;
+
+static const size_t KB = 1024, MB = 1024 * KB;
+
+// Send successful requests of the same size and latency, one
+// millisecond apart
+static AIMDLimit::Clock::time_point warmUp(AIMDLimit &limit,
+                                           size_t n,
+                                           int64_t latency,
+                                           size_t bytes,
+                                           AIMDLimit::Clock::time_point now)
+{
+    for (size_t i = 0; i < n; i++) {
+        now += std::chrono::milliseconds(1);
+        limit.update(true, false, std::chrono::microseconds(latency),
+                     bytes, now);
+    }
+    return now;
+}
+
+static void testClasses()
+{
+    CHECK(AIMDLimit::getClass(0) == 0);
+    CHECK(AIMDLimit::getClass(64 * KB) == 0);
+    CHECK(AIMDLimit::getClass(MB - 1) == 0);
+    CHECK(AIMDLimit::getClass(MB) == 1);
+    CHECK(AIMDLimit::getClass(16 * MB - 1) == 1);
+    CHECK(AIMDLimit::getClass(16 * MB) == 2);
+    CHECK(AIMDLimit::getClass(1024 * MB) == 2);
+}
+
+static void testIncrease()
+{
+    // One per window of successful requests, up to the maximum
+    AIMDLimit limit(4, 6);
+    auto now = warmUp(limit, 5, 1000, KB, AIMDLimit::Clock::now());
+    CHECK(std::floor(limit.getLimit()) == 5);
+    warmUp(limit, 100, 1000, KB, now);
+    CHECK(limit.getLimit() == 6);
+
+    // Failed requests do not increase the limit
+    AIMDLimit failed(4, 6);
+    failed.update(false, false, std::chrono::microseconds(1000), 0,
+                  AIMDLimit::Clock::now());
+    CHECK(failed.getLimit() == 4);
+
+    // Initial limit is within [1, max]
+    CHECK(AIMDLimit(0, 6).getLimit() == 1);
+    CHECK(AIMDLimit(10, 6).getLimit() == 6);
+}
+
+static void testSpike()
+{
+    // No spikes are detected during warm-up
+    AIMDLimit limit(16, 16);
+    auto now = warmUp(limit, LIMITER_WARMUP - 1, 1000, KB,
+                      AIMDLimit::Clock::now());
+    limit.update(true, false, std::chrono::microseconds(10000), KB, now);
+    CHECK(limit.getLimit() == 16);
+
+    // A spike in the same class halves the limit
+    now = warmUp(limit, LIMITER_WARMUP, 1000, KB, now);
+    double before = limit.getLimit();
+    now += std::chrono::milliseconds(1);
+    CHECK(limit.update(true, false, std::chrono::microseconds(10000),
+                       KB, now) != NULL);
+    CHECK(limit.getLimit() == before / 2);
+}
+
+static void testLargeTransfer()
+{
+    // A large GET taking longer than small ones is not a spike
+    AIMDLimit limit(16, 16);
+    auto now = warmUp(limit, LIMITER_WARMUP, 1000, 64 * KB,
+                      AIMDLimit::Clock::now());
+    now += std::chrono::milliseconds(1);
+    CHECK(limit.update(true, false, std::chrono::microseconds(500000),
+                       64 * MB, now) == NULL);
+    CHECK(limit.getLimit() == 16);
+    CHECK(limit.getLatency(64 * KB) == 1000);
+    CHECK(limit.getLatency(64 * MB) == 500000);
+
+    // Once large transfers are warmed up, their spikes are detected
+    now = warmUp(limit, LIMITER_WARMUP, 500000, 64 * MB, now);
+    now += std::chrono::seconds(1);
+    CHECK(limit.update(true, false, std::chrono::microseconds(2000000),
+                       64 * MB, now) != NULL);
+    CHECK(limit.getLimit() == 8);
+}
+
+static void testThrottled()
+{
+    // A burst of throttled requests halves the limit once per
+    // smoothed latency, down to one
+    AIMDLimit limit(16, 16);
+    auto now = warmUp(limit, LIMITER_WARMUP, 1000, KB,
+                      AIMDLimit::Clock::now());
+    now += std::chrono::milliseconds(1);
+    CHECK(limit.update(false, true, std::chrono::microseconds(100),
+                       0, now) != NULL);
+    CHECK(limit.getLimit() == 8);
+    now += std::chrono::microseconds(500);
+    CHECK(limit.update(false, true, std::chrono::microseconds(100),
+                       0, now) == NULL);
+    CHECK(limit.getLimit() == 8);
+    for (int i = 0; i < 10; i++) {
+        now += std::chrono::milliseconds(1);
+        limit.update(false, true, std::chrono::microseconds(100), 0, now);
+    }
+    CHECK(limit.getLimit() == 1);
+}
+
+int main()
+{
+    testClasses();
+    testIncrease();
+    testSpike();
+    testLargeTransfer();
+    testThrottled();
+
+    if (failures) {
+        std::cerr << failures << " checks failed" << std::endl;
+        return 1;
+    }
+    std::cout << "AIMDLimit tests passed" << std::endl;
+    return 0;
+}